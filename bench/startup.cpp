@@ -0,0 +1,80 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#include <spawn.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*
+
+startup benchmark:
+    every executable is spawned and waited for repeatedly, the time
+    from spawning to exit is measured, for an empty program (e.g.
+    'begin end.') it is the time of loading, relocating and
+    initializing runtime before the main function, so different
+    linking modes (e.g. '--static', '--static-pie') can be compared
+
+*/
+
+extern char **environ;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// spawn 'exe' with output discarded, return elapsed microseconds,
+// or a negative value if failed
+double RunOnce(const char *exe) {
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+            O_WRONLY, 0);
+    char *argv[] = {const_cast<char *>(exe), nullptr};
+    auto start = Clock::now();
+    pid_t pid;
+    auto ret = posix_spawn(&pid, exe, &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (ret) return -1;
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) return -1;
+    std::chrono::duration<double, std::micro> elapsed = Clock::now() - start;
+    return elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, const char *argv[]) {
+    int count = 1000, first = 1;
+    if (argc > 2 && !std::strcmp(argv[1], "-n")) {
+        count = std::atoi(argv[2]);
+        first = 3;
+    }
+    if (count <= 0 || first >= argc) {
+        std::cout << "usage: " << argv[0] << " [-n <count>] <executable>..."
+                  << std::endl;
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(1);
+    for (int i = first; i < argc; ++i) {
+        std::vector<double> times;
+        // warm up page cache
+        if (RunOnce(argv[i]) < 0) {
+            std::cerr << "could not run '" << argv[i] << "'" << std::endl;
+            return 1;
+        }
+        for (int j = 0; j < count; ++j) times.push_back(RunOnce(argv[i]));
+        std::sort(times.begin(), times.end());
+        double sum = 0;
+        for (const auto &t : times) sum += t;
+        std::cout << argv[i] << ": mean " << sum / count << " us, min ";
+        std::cout << times.front() << " us, median " << times[count / 2];
+        std::cout << " us" << std::endl;
+    }
+    return 0;
+}
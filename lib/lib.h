@@ -1,6 +1,17 @@
 #ifndef PL01_LIB_LIB_H_
 #define PL01_LIB_LIB_H_
 
+// called by the main function of program which uses command line
+// arguments, before any other functions
+void SetCommandLineArgs(int count, char **values);
+// called by procedures/functions which create arrays/strings that never
+// escape, those are allocated in an arena instead of pool, and released
+// when leaving the frame returned by 'EnterFrame'
+int EnterFrame();
+void LeaveFrame(int frame);
+int NewLocalArray();
+int NewLocalString(int size);
+
 int quit(int num);
 int getargcount();
 int getargvalue(int i);
@@ -12,16 +12,43 @@ typedef struct ArrayProto {
     unsigned int len;
 } Array;
 
+// initial buffer is allocated together with the array
+static unsigned int GetArraySize() {
+    return sizeof(Array) + kInitBufferSize * sizeof(int);
+}
+
+static int *GetInitBuffer(Array *a) {
+    return (int *)(a + 1);
+}
+
+static void InitArray(Array *a) {
+    a->ptr = GetInitBuffer(a);
+    a->buffer_size = kInitBufferSize;
+    a->len = 0;
+}
+
+static void ResizeBuffer(Array *a, unsigned int buffer_size) {
+    void *ptr;
+    if (a->ptr == GetInitBuffer(a)) {
+        // initial buffer can not be reallocated
+        ptr = malloc(buffer_size * sizeof(int));
+        if (ptr) memcpy(ptr, a->ptr, a->buffer_size * sizeof(int));
+    }
+    else {
+        ptr = realloc(a->ptr, buffer_size * sizeof(int));
+    }
+    // abort when allocation failure
+    if (!ptr) abort();
+    a->ptr = ptr;
+    a->buffer_size = buffer_size;
+}
+
 int newarray() {
     // allocate new array
     PoolUnit unit;
-    unit.ptr = malloc(sizeof(Array));
+    unit.ptr = malloc(GetArraySize());
     unit.size = sizeof(Array);
-    // initialize array
-    Array *arr = unit.ptr;
-    arr->buffer_size = kInitBufferSize;
-    arr->ptr = malloc(arr->buffer_size * sizeof(int));
-    arr->len = 0;
+    InitArray(unit.ptr);
     return PoolAllocaUnit(unit);
 }
 
@@ -30,12 +57,32 @@ int freearray(int arr) {
     assert(unit && unit->size == sizeof(Array));
     // destroy array
     Array *a = unit->ptr;
-    free(a->ptr);
+    if (a->ptr != GetInitBuffer(a)) free(a->ptr);
+    // arrays in arena are released with their frames
+    if (!PoolIsInlineData(unit)) free(a);
     // free unit
     PoolFreeUnit(arr);
     return 0;
 }
 
+int EnterFrame() {
+    return PoolArenaMark();
+}
+
+void LeaveFrame(int frame) {
+    PoolArenaRelease(frame);
+}
+
+int NewLocalArray() {
+    PoolId id;
+    PoolUnit *unit = PoolArenaAllocaUnit(GetArraySize(), &id);
+    // fall back to pool if arena is full
+    if (!unit) return newarray();
+    unit->size = sizeof(Array);
+    InitArray(unit->ptr);
+    return id;
+}
+
 int getarraypos(int arr, int pos) {
     PoolUnit *unit = PoolAccessUnit(arr);
     assert(unit && unit->size == sizeof(Array));
@@ -99,18 +146,8 @@ int arraypush(int arr, int value) {
     Array *a = unit->ptr;
     // increase length of array
     ++a->len;
-    if (a->len > a->buffer_size) {
-        // need to reallocate memory
-        a->buffer_size *= 2;
-        void *ptr = realloc(a->ptr, a->buffer_size * sizeof(int));
-        if (!ptr) {
-            free(a->ptr);
-            abort();
-        }
-        else {
-            a->ptr = ptr;
-        }
-    }
+    // need to reallocate memory
+    if (a->len > a->buffer_size) ResizeBuffer(a, a->buffer_size * 2);
     // put value into back of array
     a->ptr[a->len - 1] = value;
     return 0;
@@ -131,17 +168,7 @@ int arrayresize(int arr, int size) {
     int old_len = a->len;
     a->len = size;
     // need to reallocate memory
-    if (a->len > a->buffer_size) {
-        a->buffer_size = a->len * 2;
-        void *ptr = realloc(a->ptr, a->buffer_size * sizeof(int));
-        if (!ptr) {
-            free(a->ptr);
-            abort();
-        }
-        else {
-            a->ptr = ptr;
-        }
-    }
+    if (a->len > a->buffer_size) ResizeBuffer(a, a->len * 2);
     // initialize new memory
     if (size > old_len) {
         memset(a->ptr + old_len, 0, (size - old_len) * sizeof(int));
@@ -7,6 +7,24 @@
 
 // NOTE: a stupid implementation of variable length string
 
+// reallocate memory of string for 'size' characters,
+// strings in arena are moved to heap
+static void ResizeString(PoolUnit *unit, unsigned int size) {
+    void *mem;
+    if (PoolIsInlineData(unit)) {
+        mem = malloc((size + 1) * sizeof(char));
+        unsigned int len = unit->size < size ? unit->size : size;
+        if (mem) memcpy(mem, unit->ptr, (len + 1) * sizeof(char));
+    }
+    else {
+        mem = realloc(unit->ptr, (size + 1) * sizeof(char));
+    }
+    // abort when allocation failure
+    if (!mem) abort();
+    unit->ptr = mem;
+    unit->size = size;
+}
+
 int newstring(int size) {
     PoolUnit unit;
     unit.ptr = malloc((size + 1) * sizeof(char));   // '\0'
@@ -15,10 +33,21 @@ int newstring(int size) {
     return PoolAllocaUnit(unit);
 }
 
+int NewLocalString(int size) {
+    PoolId id;
+    PoolUnit *unit = PoolArenaAllocaUnit((size + 1) * sizeof(char), &id);
+    // fall back to pool if arena is full
+    if (!unit) return newstring(size);
+    unit->size = size;
+    ((char *)unit->ptr)[size] = '\0';
+    return id;
+}
+
 int freestring(int str) {
     PoolUnit *unit = PoolAccessUnit(str);
     assert(unit);
-    free(unit->ptr);
+    // strings in arena are released with their frames
+    if (!PoolIsInlineData(unit)) free(unit->ptr);
     PoolFreeUnit(str);
     return 0;
 }
@@ -70,15 +99,7 @@ int stringconcat(int dest, int src) {
     PoolUnit *s1 = PoolAccessUnit(dest), *s2 = PoolAccessUnit(src);
     assert(s1 && s2);
     // reallocate memory for new string
-    void *mem = realloc(s1->ptr, (s1->size + s2->size + 1) * sizeof(char));
-    if (!mem) {
-        free(s1->ptr);
-        abort();
-    }
-    else {
-        s1->ptr = mem;
-        s1->size += s2->size;
-    }
+    ResizeString(s1, s1->size + s2->size);
     // string concatenation
     strcat(s1->ptr, s2->ptr);
     return dest;
@@ -94,15 +115,7 @@ int stringassign(int dest, int src) {
     PoolUnit *s1 = PoolAccessUnit(dest), *s2 = PoolAccessUnit(src);
     assert(s1 && s2);
     // reallocate memory for new string
-    void *mem = realloc(s1->ptr, (s2->size + 1) * sizeof(char));
-    if (!mem) {
-        free(s1->ptr);
-        abort();
-    }
-    else {
-        s1->ptr = mem;
-        s1->size = s2->size;
-    }
+    ResizeString(s1, s2->size);
     // cpoy string
     strcpy(s1->ptr, s2->ptr);
     return dest;
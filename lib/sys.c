@@ -8,31 +8,46 @@
 
 #include <util/pool.h>
 
+// command line arguments, set by the main function of program,
+// or got from system when they are first used
 static int argc = -1;
+static char **argv = NULL;
 static PoolId *p_argv = NULL;
 
-static int InitCommandLineArgs() {
+void SetCommandLineArgs(int count, char **values) {
+    argc = count;
+    argv = values;
+}
+
+static int GetCommandLineArgs() {
+    if (argc >= 0) return 0;
 #ifdef __APPLE__
     // get pointer of argc
     int *pargc = _NSGetArgc();
     if (!pargc) return -1;
-    argc = *pargc;
     // get pointer of argv
     char ***pargv = _NSGetArgv();
     if (!pargv) return -1;
+    SetCommandLineArgs(*pargc, *pargv);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+// put arguments into pool lazily
+static int InitCommandLineArgs() {
+    if (GetCommandLineArgs() < 0) return -1;
     // allocate spaces
     p_argv = (PoolId *)malloc(argc * sizeof(PoolId));
     if (!p_argv) return -1;
     PoolUnit unit;
     for (int i = 0; i < argc; ++i) {
-        unit.ptr = (*pargv)[i];
+        unit.ptr = argv[i];
         unit.size = strlen(unit.ptr);
         p_argv[i] = PoolAllocaUnit(unit);
     }
     return 0;
-#else
-    return -1;
-#endif
 }
 
 int quit(int num) {
@@ -41,7 +56,7 @@ int quit(int num) {
 }
 
 int getargcount() {
-    if (argc == -1) InitCommandLineArgs();
+    GetCommandLineArgs();
     return argc;
 }
 
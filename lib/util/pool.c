@@ -1,6 +1,9 @@
 #include <util/pool.h>
 
 static const int kPoolInitSize = 32;
+static const unsigned int kArenaSize = 1 << 20;
+// ids of arena units, offsets of their blocks in arena
+static const PoolId kArenaFlag = 0x80000000;
 
 typedef struct PoolIdListProto {
     PoolId id;
@@ -11,6 +14,15 @@ static PoolUnit *pool = NULL;
 static PoolIdList *freed_id_list = NULL;
 static PoolId pool_size = 0, next_id = 0;
 
+typedef struct ArenaBlockProto {
+    // size of block, including data
+    unsigned int size;
+    PoolUnit unit;
+} ArenaBlock;
+
+static char *arena = NULL;
+static unsigned int arena_top = 0;
+
 void InitializePool() {
     // free allocated memory of pool
     if (pool) free(pool);
@@ -32,6 +44,10 @@ int IsPoolInitialized() {
 }
 
 PoolUnit *PoolAccessUnit(PoolId id) {
+    if (id & kArenaFlag) {
+        id &= ~kArenaFlag;
+        return id < arena_top ? &((ArenaBlock *)(arena + id))->unit : NULL;
+    }
     return id < next_id ? pool + id : NULL;
 }
 
@@ -71,9 +87,48 @@ PoolId PoolAllocaUnit(PoolUnit unit) {
 
 // NOTE: unsafe when free an id twice
 void PoolFreeUnit(PoolId id) {
+    if (id & kArenaFlag) {
+        // release block if it is on the top of arena,
+        // otherwise it will be released with its frame
+        id &= ~kArenaFlag;
+        if (id + ((ArenaBlock *)(arena + id))->size == arena_top) {
+            arena_top = id;
+        }
+        return;
+    }
     // insert id info 'freed id' linked list
     PoolIdList *ptr = (PoolIdList *)malloc(sizeof(PoolIdList));
     ptr->id = id;
     ptr->next = freed_id_list;
     freed_id_list = ptr;
 }
+
+unsigned int PoolArenaMark() {
+    return arena_top;
+}
+
+void PoolArenaRelease(unsigned int mark) {
+    if (mark < arena_top) arena_top = mark;
+}
+
+PoolUnit *PoolArenaAllocaUnit(unsigned int size, PoolId *id) {
+    // allocate arena on first use
+    if (!arena) {
+        arena = (char *)malloc(kArenaSize);
+        if (!arena) abort();
+    }
+    // keep blocks aligned
+    size = (sizeof(ArenaBlock) + size + 7) & ~7u;
+    if (size > kArenaSize - arena_top) return NULL;
+    ArenaBlock *block = (ArenaBlock *)(arena + arena_top);
+    block->size = size;
+    block->unit.ptr = block + 1;
+    block->unit.size = size - sizeof(ArenaBlock);
+    *id = arena_top | kArenaFlag;
+    arena_top += size;
+    return &block->unit;
+}
+
+int PoolIsInlineData(const PoolUnit *unit) {
+    return unit->ptr == unit + 1;
+}
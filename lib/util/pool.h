@@ -16,4 +16,16 @@ PoolUnit *PoolAccessUnit(PoolId id);
 PoolId PoolAllocaUnit(PoolUnit unit);
 void PoolFreeUnit(PoolId id);
 
+// arena of units which never escape from the procedure/function that
+// allocates them, units are allocated like a stack without touching
+// the pool, data of unit is allocated together with it, and all units
+// allocated after 'mark' are released by 'PoolArenaRelease'
+unsigned int PoolArenaMark();
+void PoolArenaRelease(unsigned int mark);
+// allocate unit with 'size' bytes of data in arena, return NULL if
+// arena is full
+PoolUnit *PoolArenaAllocaUnit(unsigned int size, PoolId *id);
+// check if data of unit is allocated together with the unit
+int PoolIsInlineData(const PoolUnit *unit);
+
 #endif // PL01_LIB_UTIL_POOL_H_
@@ -0,0 +1,170 @@
+#include <define/flatast.h>
+
+#include <cassert>
+#include <cstddef>
+
+namespace {
+
+using NodeId = FlatAST::NodeId;
+
+// IR generator of flat AST, the same as 'BaseAST::GenerateIR'
+class IRGenerator : public FlatASTVisitor<IRGenerator, IRPtr> {
+public:
+    IRGenerator(const FlatAST &ast, IRBuilder &irb)
+            : FlatASTVisitor(ast), irb_(irb) {}
+
+    IRPtr VisitBlock(NodeId id);
+    IRPtr VisitConsts(NodeId id);
+    IRPtr VisitVars(NodeId id);
+    IRPtr VisitDef(NodeId id);
+    IRPtr VisitProcedure(NodeId id);
+    IRPtr VisitFunction(NodeId id);
+    IRPtr VisitAssign(NodeId id);
+    IRPtr VisitBeginEnd(NodeId id);
+    IRPtr VisitIf(NodeId id);
+    IRPtr VisitWhile(NodeId id);
+    IRPtr VisitAsm(NodeId id);
+    IRPtr VisitControl(NodeId id);
+    IRPtr VisitUnary(NodeId id);
+    IRPtr VisitBinary(NodeId id);
+    IRPtr VisitFunCall(NodeId id);
+    IRPtr VisitId(NodeId id);
+    IRPtr VisitNumber(NodeId id);
+
+private:
+    // generator of an optional child, must outlive the 'LazyIRGen'
+    class ChildGen {
+    public:
+        ChildGen(IRGenerator &gen, NodeId id) : gen_(gen), id_(id) {}
+
+        IRPtr operator()() { return gen_.Visit(id_); }
+        LazyIRGen ref() {
+            if (id_ == FlatAST::kNullNode) return nullptr;
+            return LazyIRGen(*this);
+        }
+
+    private:
+        IRGenerator &gen_;
+        NodeId id_;
+    };
+
+    IRBuilder &irb_;
+};
+
+IRPtr IRGenerator::VisitBlock(NodeId id) {
+    auto c = ast().children(id);
+    ChildGen consts(*this, c[0]), vars(*this, c[1]), stat(*this, c[2]);
+    return irb_.GenerateBlock(consts.ref(), vars.ref(), [this, c] {
+                for (auto it = c.begin() + 3; it != c.end(); ++it) {
+                    Visit(*it);
+                }
+                return nullptr;
+            }, stat.ref());
+}
+
+IRPtr IRGenerator::VisitConsts(NodeId id) {
+    for (const auto &i : ast().children(id)) {
+        irb_.GenerateConst(ast().name(i), ast().binding(i), Visit(i));
+    }
+    return nullptr;
+}
+
+IRPtr IRGenerator::VisitVars(NodeId id) {
+    for (const auto &i : ast().children(id)) {
+        irb_.GenerateVar(ast().name(i), ast().binding(i), Visit(i));
+    }
+    return nullptr;
+}
+
+IRPtr IRGenerator::VisitDef(NodeId id) {
+    // generate the initializer only, definition is handled by parent
+    auto init = ast().child(id, 0);
+    return init != FlatAST::kNullNode ? Visit(init) : nullptr;
+}
+
+IRPtr IRGenerator::VisitProcedure(NodeId id) {
+    if (!ast().is_used(id)) return nullptr;
+    ChildGen block(*this, ast().child(id, 0));
+    return irb_.GenerateProcedure(ast().name(id), ast().binding(id),
+            ast().captures(id), block.ref());
+}
+
+IRPtr IRGenerator::VisitFunction(NodeId id) {
+    if (!ast().is_used(id)) return nullptr;
+    auto c = ast().children(id);
+    IdList args;
+    for (auto it = c.begin() + 1; it != c.end(); ++it) {
+        args.push_back(ast().name(*it));
+    }
+    ChildGen block(*this, c[0]);
+    return irb_.GenerateFunction(ast().name(id), ast().binding(id), args,
+            ast().captures(id), block.ref());
+}
+
+IRPtr IRGenerator::VisitAssign(NodeId id) {
+    const auto &bind = ast().binding(id);
+    assert(bind.type != SymbolType::Error);
+    return irb_.GenerateAssign(bind, Visit(ast().child(id, 0)),
+            ast().is_tail(id));
+}
+
+IRPtr IRGenerator::VisitBeginEnd(NodeId id) {
+    for (const auto &i : ast().children(id)) Visit(i);
+    return nullptr;
+}
+
+IRPtr IRGenerator::VisitIf(NodeId id) {
+    auto c = ast().children(id);
+    ChildGen then(*this, c[1]), else_then(*this, c[2]);
+    return irb_.GenerateIf(Visit(c[0]), then.ref(), else_then.ref());
+}
+
+IRPtr IRGenerator::VisitWhile(NodeId id) {
+    auto c = ast().children(id);
+    ChildGen cond(*this, c[0]), body(*this, c[1]);
+    return irb_.GenerateWhile(cond.ref(), body.ref());
+}
+
+IRPtr IRGenerator::VisitAsm(NodeId id) {
+    return irb_.GenerateAsm(ast().name(id));
+}
+
+IRPtr IRGenerator::VisitControl(NodeId id) {
+    return irb_.GenerateControl(ast().keyword(id));
+}
+
+IRPtr IRGenerator::VisitUnary(NodeId id) {
+    // 'odd' only
+    assert(ast().keyword(id) == Lexer::Keyword::Odd);
+    return irb_.GenerateUnary(Visit(ast().child(id, 0)));
+}
+
+IRPtr IRGenerator::VisitBinary(NodeId id) {
+    auto lhs = Visit(ast().child(id, 0));
+    auto rhs = Visit(ast().child(id, 1));
+    return irb_.GenerateBinary(ast().op(id), lhs, rhs);
+}
+
+IRPtr IRGenerator::VisitFunCall(NodeId id) {
+    auto c = ast().children(id);
+    IRPtrBuffer args(c.size());
+    for (std::size_t i = 0; i < c.size(); ++i) args[i] = Visit(c[i]);
+    return irb_.GenerateFunCall(ast().binding(id), args);
+}
+
+IRPtr IRGenerator::VisitId(NodeId id) {
+    const auto &bind = ast().binding(id);
+    assert(bind.type != SymbolType::Error);
+    return irb_.GenerateId(bind);
+}
+
+IRPtr IRGenerator::VisitNumber(NodeId id) {
+    return irb_.GenerateNumber(ast().value(id));
+}
+
+} // namespace
+
+IRPtr FlatAST::GenerateIR(IRBuilder &irb, NodeId id) const {
+    if (id == kNullNode) return nullptr;
+    return IRGenerator(*this, irb).Visit(id);
+}
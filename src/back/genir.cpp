@@ -1,47 +1,63 @@
 #include <define/ast.h>
 
 #include <cassert>
+#include <cstddef>
+
+namespace {
+
+// generator of an optional child, 'gen' must outlive the result
+template <typename F>
+inline LazyIRGen MakeGen(const ASTPtr &ast, F &gen) {
+    return ast ? LazyIRGen(gen) : nullptr;
+}
+
+} // namespace
 
 IRPtr BlockAST::GenerateIR(IRBuilder &irb) {
-    LazyIRGen consts, vars, stat;
-    if (consts_) consts = [&] { return consts_->GenerateIR(irb); };
-    if (vars_) vars = [&] { return vars_->GenerateIR(irb); };
-    if (stat_) stat = [&] { return stat_->GenerateIR(irb); };
-    return irb.GenerateBlock(consts, vars, [&] {
+    auto consts = [&] { return consts_->GenerateIR(irb); };
+    auto vars = [&] { return vars_->GenerateIR(irb); };
+    auto stat = [&] { return stat_->GenerateIR(irb); };
+    return irb.GenerateBlock(MakeGen(consts_, consts),
+            MakeGen(vars_, vars), [&] {
                 for (const auto &i : proc_func_) i->GenerateIR(irb);
                 return nullptr;
-            }, stat);
+            }, MakeGen(stat_, stat));
 }
 
 IRPtr ConstsAST::GenerateIR(IRBuilder &irb) {
+    auto bind = bind_;
     for (const auto &i : defs_) {
-        irb.GenerateConst(i.first, i.second->GenerateIR(irb));
+        irb.GenerateConst(i.first, bind, i.second->GenerateIR(irb));
+        ++bind.slot;
     }
     return nullptr;
 }
 
 IRPtr VarsAST::GenerateIR(IRBuilder &irb) {
+    auto bind = bind_;
     for (const auto &i : defs_) {
         auto init = i.second ? i.second->GenerateIR(irb) : nullptr;
-        irb.GenerateVar(i.first, init);
+        irb.GenerateVar(i.first, bind, init);
+        ++bind.slot;
     }
     return nullptr;
 }
 
 IRPtr ProcedureAST::GenerateIR(IRBuilder &irb) {
-    return irb.GenerateProcedure(id_,
+    if (!is_used_) return nullptr;
+    return irb.GenerateProcedure(id_, bind_, captures_,
             [&] { return block_->GenerateIR(irb); });
 }
 
 IRPtr FunctionAST::GenerateIR(IRBuilder &irb) {
-    return irb.GenerateFunction(id_, args_,
+    if (!is_used_) return nullptr;
+    return irb.GenerateFunction(id_, bind_, args_, captures_,
             [&] { return block_->GenerateIR(irb); });
 }
 
 IRPtr AssignAST::GenerateIR(IRBuilder &irb) {
-    auto info = env()->GetInfo(id_);
-    assert(info.type != SymbolType::Error);
-    return irb.GenerateAssign(id_, expr_->GenerateIR(irb), info.type);
+    assert(bind_.type != SymbolType::Error);
+    return irb.GenerateAssign(bind_, expr_->GenerateIR(irb), is_tail_);
 }
 
 IRPtr BeginEndAST::GenerateIR(IRBuilder &irb) {
@@ -52,16 +68,22 @@ IRPtr BeginEndAST::GenerateIR(IRBuilder &irb) {
 }
 
 IRPtr IfAST::GenerateIR(IRBuilder &irb) {
-    LazyIRGen then, else_then;
-    if (then_) then = [&] { return then_->GenerateIR(irb); };
-    if (else_then_) else_then = [&] { return else_then_->GenerateIR(irb); };
-    return irb.GenerateIf(cond_->GenerateIR(irb), then, else_then);
+    if (is_pruned_) {
+        // only the live branch is left
+        const auto &live = then_ ? then_ : else_then_;
+        return live ? live->GenerateIR(irb) : nullptr;
+    }
+    auto then = [&] { return then_->GenerateIR(irb); };
+    auto else_then = [&] { return else_then_->GenerateIR(irb); };
+    return irb.GenerateIf(cond_->GenerateIR(irb), MakeGen(then_, then),
+            MakeGen(else_then_, else_then));
 }
 
 IRPtr WhileAST::GenerateIR(IRBuilder &irb) {
-    LazyIRGen body;
-    if (body_) body = [&] { return body_->GenerateIR(irb); };
-    return irb.GenerateWhile([&] { return cond_->GenerateIR(irb); }, body);
+    if (is_pruned_) return nullptr;
+    auto body = [&] { return body_->GenerateIR(irb); };
+    return irb.GenerateWhile([&] { return cond_->GenerateIR(irb); },
+            MakeGen(body_, body));
 }
 
 IRPtr AsmAST::GenerateIR(IRBuilder &irb) {
@@ -75,26 +97,32 @@ IRPtr ControlAST::GenerateIR(IRBuilder &irb) {
 IRPtr UnaryAST::GenerateIR(IRBuilder &irb) {
     static_cast<void>(op_);     // 'odd' only
     assert(op_ == Lexer::Keyword::Odd);
+    if (is_const_) return irb.GenerateNumber(value_);
     return irb.GenerateUnary(operand_->GenerateIR(irb));
 }
 
 IRPtr BinaryAST::GenerateIR(IRBuilder &irb) {
-    return irb.GenerateBinary(op_,
-            lhs_->GenerateIR(irb), rhs_->GenerateIR((irb)));
+    if (is_const_) return irb.GenerateNumber(value_);
+    // operands must be generated in order
+    auto lhs = lhs_->GenerateIR(irb);
+    auto rhs = rhs_->GenerateIR(irb);
+    return irb.GenerateBinary(op_, lhs, rhs);
 }
 
 IRPtr FunCallAST::GenerateIR(IRBuilder &irb) {
-    IRPtrList args;
-    for (const auto &i : args_) {
-        args.push_back(i->GenerateIR(irb));
+    if (is_const_) return irb.GenerateNumber(value_);
+    IRPtrBuffer args(args_.size());
+    for (std::size_t i = 0; i < args_.size(); ++i) {
+        args[i] = args_[i]->GenerateIR(irb);
     }
-    return irb.GenerateFunCall(id_, args);
+    assert(bind_.type != SymbolType::Error);
+    return irb.GenerateFunCall(bind_, args);
 }
 
 IRPtr IdAST::GenerateIR(IRBuilder &irb) {
-    auto info = env()->GetInfo(id_);
-    assert(info.type != SymbolType::Error);
-    return irb.GenerateId(id_, info.type);
+    assert(bind_.type != SymbolType::Error);
+    if (is_const_) return irb.GenerateNumber(value_);
+    return irb.GenerateId(bind_);
 }
 
 IRPtr NumberAST::GenerateIR(IRBuilder &irb) {
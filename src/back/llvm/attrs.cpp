@@ -0,0 +1,106 @@
+#include <back/llvm/attrs.h>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/IR/Attributes.h>
+#include <llvm/IR/CallingConv.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/InstIterator.h>
+
+void InferFunctionAttrs(llvm::Function &func, bool has_runtime) {
+    using namespace llvm;
+    bool reads = false, writes = false, may_throw = false;
+    bool may_recurse = false, may_not_return = false;
+    // loops are back edges in layout order
+    DenseMap<const BasicBlock *, unsigned int> order;
+    for (const auto &block : func) order.insert({&block, order.size()});
+    for (const auto &block : func) {
+        for (auto succ : successors(&block)) {
+            if (order.lookup(succ) <= order.lookup(&block)) {
+                may_not_return = true;
+            }
+        }
+        for (const auto &inst : block) {
+            if (auto load = dyn_cast<LoadInst>(&inst)) {
+                if (!isa<AllocaInst>(load->getPointerOperand())) reads = true;
+            }
+            else if (auto store = dyn_cast<StoreInst>(&inst)) {
+                if (!isa<AllocaInst>(store->getPointerOperand())) {
+                    writes = true;
+                }
+            }
+            else if (auto call = dyn_cast<CallInst>(&inst)) {
+                auto callee = call->getCalledFunction();
+                if (callee == &func) {
+                    may_recurse = may_not_return = true;
+                }
+                else if (callee && callee->isDeclaration() && has_runtime) {
+                    reads = writes = may_not_return = true;
+                }
+                else if (callee) {
+                    if (!callee->doesNotAccessMemory()) {
+                        reads = true;
+                        if (!callee->onlyReadsMemory()) writes = true;
+                    }
+                    if (!callee->doesNotThrow()) may_throw = true;
+                    if (!callee->doesNotRecurse()) may_recurse = true;
+                    if (!callee->hasFnAttribute(Attribute::WillReturn)) {
+                        may_not_return = true;
+                    }
+                }
+                else {
+                    // inline assembly
+                    reads = writes = may_throw = true;
+                    may_recurse = may_not_return = true;
+                }
+            }
+        }
+    }
+    if (!writes) {
+        func.addFnAttr(reads ? Attribute::ReadOnly : Attribute::ReadNone);
+    }
+    if (!may_throw) func.setDoesNotThrow();
+    if (!may_recurse) func.setDoesNotRecurse();
+    if (!may_not_return) func.addFnAttr(Attribute::WillReturn);
+}
+
+void InternalizeSymbols(llvm::Module &module) {
+    using namespace llvm;
+    for (auto &var : module.globals()) {
+        if (!var.isDeclaration()) var.setLinkage(GlobalValue::InternalLinkage);
+    }
+    DenseSet<Function *> fast_funcs;
+    for (auto &func : module) {
+        if (!func.isDeclaration() && func.getName() != "main") {
+            func.setLinkage(Function::InternalLinkage);
+            fast_funcs.insert(&func);
+        }
+    }
+    // caller and callee of a 'musttail' call must have the same
+    // calling convention, so they are both 'fastcc' or neither
+    for (auto changed = true; changed;) {
+        changed = false;
+        for (auto &func : module) {
+            for (auto &inst : instructions(func)) {
+                auto call = dyn_cast<CallInst>(&inst);
+                if (!call || !call->isMustTailCall()) continue;
+                auto callee = call->getCalledFunction();
+                if (fast_funcs.count(&func) != fast_funcs.count(callee)) {
+                    changed |= fast_funcs.erase(&func);
+                    changed |= fast_funcs.erase(callee);
+                }
+            }
+        }
+    }
+    // update procedures/functions and their call sites
+    for (auto func : fast_funcs) {
+        func->setCallingConv(CallingConv::Fast);
+        for (auto user : func->users()) {
+            auto call = dyn_cast<CallInst>(user);
+            if (call && call->getCalledFunction() == func) {
+                call->setCallingConv(CallingConv::Fast);
+            }
+        }
+    }
+}
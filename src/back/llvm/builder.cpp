@@ -1,53 +1,60 @@
 #include <back/llvm/builder.h>
 
 #include <vector>
+#include <sstream>
+#include <cstdint>
 #include <cassert>
 
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/ADT/APInt.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/InlineAsm.h>
-#include <llvm/Transforms/Utils.h>
-#include <llvm/Transforms/InstCombine/InstCombine.h>
-#include <llvm/Transforms/Scalar.h>
-#include <llvm/Transforms/Scalar/GVN.h>
 #include <llvm/Support/TargetSelect.h>
-#include <llvm/Support/TargetRegistry.h>
-#include <llvm/Target/TargetMachine.h>
-#include <llvm/Target/TargetOptions.h>
 #include <llvm/Support/FileSystem.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/ADT/SmallVector.h>
 
 #include <back/llvm/ir.h>
+#include <back/llvm/codegen.h>
+#include <back/llvm/attrs.h>
+#include <back/llvm/specialize.h>
+#include <back/llvm/escape.h>
 
 namespace {
 
-inline llvm::Value *GetValue(const IRPtr &ir) {
-    assert(ir);
-    auto v = IRCast<llvm::Value *>(ir);
-    assert(v);
-    return v;
-}
-
-inline IRPtr MakeIR(llvm::Value *value) {
-    return std::make_shared<LLVMIR>(value);
+// identifier of local variable in 'SSABuilder'
+inline SSABuilder::Var GetVar(const Binding &bind) {
+    return GetBindingKey(bind);
 }
 
 } // namespace
 
-void LLVMIRBuilder::InitializeFPM() {
-    using namespace llvm;
-    fpm_ = std::make_unique<legacy::FunctionPassManager>(module_.get());
-    // allocas to registers
-    fpm_->add(createPromoteMemoryToRegisterPass());
-    // peephole optimizations
-    fpm_->add(createInstructionCombiningPass());
-    // reassociate expressions
-    fpm_->add(createReassociatePass());
-    // eliminate common sub-expressions
-    fpm_->add(createGVNPass());
-    // simplify the control flow graph
-    fpm_->add(createCFGSimplificationPass());
-    fpm_->doInitialization();
+void LLVMIRBuilder::OptimizeFunction(llvm::Function *func) {
+    if (func->isDeclaration()) return;
+    if (size_level_ != SizeLevel::None) {
+        SetSizeLevel(*func, size_level_);
+        if (remarks_) {
+            sizes_.push_back({func->getName().str(),
+                    func->getInstructionCount()});
+        }
+    }
+    std::string message;
+    if (jobs_ > 1) {
+        // optimized after whole-program optimizations by 'EmitArchive',
+        // so choose its pipeline now, before the body is changed by them
+        message = RecordPipeline(*func);
+    }
+    else {
+        if (!opt_) {
+            opt_ = std::make_unique<FunctionOptimizer>(module_.get(),
+                    opt_budget_);
+        }
+        message = opt_->Run(*func);
+    }
+    if (!message.empty()) Remark(func->getName().str(), message);
 }
 
 void LLVMIRBuilder::InitializeTarget() {
@@ -59,35 +66,320 @@ void LLVMIRBuilder::InitializeTarget() {
     llvm::InitializeAllAsmPrinters();
 }
 
-llvm::AllocaInst *LLVMIRBuilder::CreateAlloca(llvm::Function *func) {
-    auto &entry = func->getEntryBlock();
-    llvm::IRBuilder<> builder(&entry, entry.begin());
-    return builder.CreateAlloca(builder_.getInt32Ty());
+void LLVMIRBuilder::EnterFunction(llvm::Function *func) {
+    cur_func_.push(func);
+    ssa_.emplace(builder_.getInt32Ty());
+    mem_vars_.emplace();
+    var_ptrs_.emplace();
+    body_entry_.push(nullptr);
+}
+
+void LLVMIRBuilder::ExitFunction() {
+    cur_func_.pop();
+    ssa_.pop();
+    mem_vars_.pop();
+    var_ptrs_.pop();
+    body_entry_.pop();
+}
+
+llvm::BasicBlock *LLVMIRBuilder::CreateIsolatedBlock() {
+    auto block = llvm::BasicBlock::Create(context_, "", cur_func_.top());
+    SealBlock(block);
+    return block;
+}
+
+llvm::Value *LLVMIRBuilder::GetCondValue(const IRPtr &cond) {
+    auto value = GetValue(cond);
+    if (value->getType()->isIntegerTy(1)) return value;
+    return builder_.CreateICmpNE(value, builder_.getInt32(0));
+}
+
+bool LLVMIRBuilder::IsLocalVar(const Binding &bind) const {
+    if (ssa_.empty()) return false;
+    auto var = GetVar(bind);
+    return ssa_.top().IsVar(var) || var_ptrs_.top().count(var);
+}
+
+void LLVMIRBuilder::DefineLocal(Var var, llvm::Value *value) {
+    if (mem_vars_.top().count(var)) {
+        // allocate stack slot in entry block
+        auto &entry = cur_func_.top()->getEntryBlock();
+        llvm::IRBuilder<> builder(&entry, entry.begin());
+        auto ptr = builder.CreateAlloca(builder_.getInt32Ty());
+        builder_.CreateStore(value, ptr);
+        var_ptrs_.top()[var] = ptr;
+    }
+    else {
+        ssa_.top().DeclareVar(var);
+        ssa_.top().WriteVar(var, builder_.GetInsertBlock(), value);
+    }
+}
+
+llvm::Value *LLVMIRBuilder::ReadLocal(Var var) {
+    auto it = var_ptrs_.top().find(var);
+    if (it != var_ptrs_.top().end()) return builder_.CreateLoad(it->second);
+    return ssa_.top().ReadVar(var, builder_.GetInsertBlock());
+}
+
+void LLVMIRBuilder::WriteLocal(Var var, llvm::Value *value) {
+    auto it = var_ptrs_.top().find(var);
+    if (it != var_ptrs_.top().end()) {
+        builder_.CreateStore(value, it->second);
+    }
+    else {
+        ssa_.top().WriteVar(var, builder_.GetInsertBlock(), value);
+    }
+}
+
+llvm::Function *LLVMIRBuilder::DeclareFunction(const std::string &id,
+        llvm::Type *ret, std::size_t arg_count,
+        const CaptureList &captures) {
+    // arguments, and then captured variables
+    std::vector<llvm::Type *> args_type(arg_count, builder_.getInt32Ty());
+    for (const auto &i : captures) {
+        auto var = GetVar(i.bind);
+        if (i.by_ref) {
+            args_type.push_back(builder_.getInt32Ty()->getPointerTo());
+            mem_vars_.top().insert(var);
+        }
+        else {
+            args_type.push_back(builder_.getInt32Ty());
+        }
+    }
+    auto func_type = llvm::FunctionType::get(ret, args_type, false);
+    auto name = NewFunName(id);
+    auto func = llvm::Function::Create(func_type,
+            llvm::Function::ExternalLinkage, name, module_.get());
+    // top level names are shared by all shards and cached objects
+    assert(func->getName() == name && "function has been renamed");
+    if (!captures.empty()) captures_[func] = captures;
+    return func;
+}
+
+void LLVMIRBuilder::GenerateCaptures(llvm::Function *func,
+        const CaptureList &captures) {
+    auto arg = func->arg_end() - captures.size();
+    for (const auto &i : captures) {
+        auto var = GetVar(i.bind);
+        if (i.by_ref) {
+            var_ptrs_.top()[var] = arg;
+        }
+        else {
+            ssa_.top().DeclareVar(var);
+            ssa_.top().WriteVar(var, builder_.GetInsertBlock(), arg);
+        }
+        ++arg;
+    }
+}
+
+bool LLVMIRBuilder::GenerateTailCall(const Binding &bind,
+        llvm::CallInst *call) {
+    auto func = cur_func_.top();
+    if (call->getCalledFunction() == func && body_entry_.top()) {
+        // self tail call, update arguments and return value, then jump
+        // back, captured variables are always the same in self calls
+        auto it = captures_.find(func);
+        auto arg_count = func->arg_size()
+                - (it != captures_.end() ? it->second.size() : 0);
+        for (std::uint32_t i = 0; i < arg_count; ++i) {
+            WriteLocal(GetVar({SymbolType::Var, bind.depth, i + 1}),
+                    call->getArgOperand(i));
+        }
+        WriteLocal(GetVar(bind), builder_.getInt32(0));
+        Remark(call, "converted to loop");
+        call->eraseFromParent();
+        builder_.CreateBr(body_entry_.top());
+    }
+    else if (CanMustTail(call)) {
+        call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+        builder_.CreateRet(call);
+        Remark(call, "lowered with 'musttail'");
+    }
+    else {
+        return false;
+    }
+    // statements after tail call are unreachable
+    builder_.SetInsertPoint(CreateIsolatedBlock());
+    return true;
+}
+
+bool LLVMIRBuilder::CanMustTail(llvm::CallInst *call) const {
+    // prototypes of caller and callee must match
+    auto func = cur_func_.top();
+    auto callee = call->getCalledFunction();
+    if (!callee || callee->getFunctionType() != func->getFunctionType()
+            || callee->getCallingConv() != func->getCallingConv()) {
+        return false;
+    }
+    // callee can not access stack slots of caller
+    for (const auto &arg : call->args()) {
+        if (llvm::isa<llvm::AllocaInst>(arg)) return false;
+    }
+    return true;
+}
+
+void LLVMIRBuilder::Remark(const llvm::CallInst *call,
+        const char *message) const {
+    if (!remarks_) return;
+    std::ostringstream oss;
+    oss << "tail call to '" << call->getCalledFunction()->getName().str();
+    oss << "' " << message;
+    Remark(cur_func_.top()->getName().str(), oss.str());
+}
+
+void LLVMIRBuilder::Remark(const std::string &func,
+        const std::string &message) const {
+    if (remarks_) PrintRemark(func, message);
+}
+
+void LLVMIRBuilder::ReportSizes(const FunctionSizes &sizes) const {
+    for (const auto &i : sizes_) {
+        std::ostringstream oss;
+        oss << "size: " << i.second << " -> ";
+        auto it = sizes.find(i.first);
+        if (it != sizes.end()) {
+            oss << it->second << " instruction(s)";
+        }
+        else {
+            oss << "0 (merged or removed)";
+        }
+        Remark(i.first, oss.str());
+    }
+    // functions created by outlining
+    FunctionSizes before(sizes_.begin(), sizes_.end());
+    for (const auto &i : sizes) {
+        if (before.count(i.first)) continue;
+        std::ostringstream oss;
+        oss << "size: 0 -> " << i.second << " instruction(s) (outlined)";
+        Remark(i.first, oss.str());
+    }
 }
 
 std::string LLVMIRBuilder::NewFunName(const std::string &id) {
+    // lifted procedures/functions are prefixed by the name of parent,
+    // which is never a valid identifier, so it can not conflict with
+    // top level ones declared later
+    if (!cur_func_.empty()) return cur_func_.top()->getName().str() + "." + id;
     // avoid naming conflict when creating a function called main
     return id != "main" ? id : "_main";
 }
 
-bool LLVMIRBuilder::CompileToObject(const char *file) {
+void LLVMIRBuilder::PassCommandLineArgs(llvm::Function *main) {
+    // external functions which read command line arguments,
+    // see 'sys.pl0' of import library
+    auto is_used = [this](const char *name) {
+        auto func = module_->getFunction(name);
+        return func && func->isDeclaration();
+    };
+    if (!is_used("getargcount") && !is_used("getargvalue")) return;
+    // call 'SetCommandLineArgs' before anything else, so runtime
+    // library need not find arguments by itself during startup
+    auto set_args = module_->getOrInsertFunction("SetCommandLineArgs",
+            builder_.getVoidTy(), builder_.getInt32Ty(),
+            builder_.getInt8PtrTy()->getPointerTo());
+    if (auto func = llvm::dyn_cast<llvm::Function>(set_args.getCallee())) {
+        func->setDoesNotThrow();
+        func->setOnlyAccessesInaccessibleMemory();
+    }
+    auto &entry = main->getEntryBlock();
+    builder_.SetInsertPoint(&entry, entry.getFirstInsertionPt());
+    auto arg = main->arg_begin();
+    builder_.CreateCall(set_args, {arg, arg + 1});
+}
+
+bool LLVMIRBuilder::IsBodyOwned() {
+    if (!cur_func_.empty() || !owned_) return true;
+    return owned_(top_index_++);
+}
+
+void LLVMIRBuilder::FinishFunction(llvm::Function *func, bool is_declare) {
+    if (!is_declare) {
+        if (!cur_func_.empty()) {
+            func->setLinkage(llvm::Function::InternalLinkage);
+        }
+        // declarations of shard may be functions of other shards
+        InferFunctionAttrs(*func, !owned_);
+    }
+    OptimizeFunction(func);
+}
+
+void LLVMIRBuilder::FinishModule() {
+    InternalizeSymbols(*module_);
+    // propagate constant arguments into clones of callees
+    for (const auto &spec : SpecializeFunctions(*module_)) {
+        if (remarks_) {
+            std::ostringstream oss;
+            oss << "specialized as '" << spec.clone->getName().str();
+            oss << "' for ";
+            for (const auto &i : spec.args) {
+                if (&i != &spec.args.front()) oss << ", ";
+                oss << "argument " << i.first + 1 << " = " << i.second;
+            }
+            oss << " (" << spec.call_count << " call site(s))";
+            Remark(spec.callee, oss.str());
+        }
+        OptimizeFunction(spec.clone);
+    }
+    // all procedures/functions of program are defined now,
+    // so the rest of declarations are runtime functions
+    for (auto &func : *module_) {
+        auto count = AllocateInFrame(func);
+        if (count && remarks_) {
+            std::ostringstream oss;
+            oss << count << " array(s)/string(s) allocated in frame arena";
+            Remark(func.getName().str(), oss.str());
+        }
+    }
+    OptimizeModule(*module_, size_level_);
+}
+
+bool LLVMIRBuilder::LinkModule(const LLVMIRBuilder &shard) {
     using namespace llvm;
-    // initialize target triple
-    std::string target_error;
-    auto target_tri = sys::getDefaultTargetTriple();
-    module_->setTargetTriple(target_tri);
-    // lookup target in target registry
-    auto target = TargetRegistry::lookupTarget(target_tri, target_error);
-    if (!target) {
-        errs() << target_error << '\n';
+    // modules can not be shared between contexts, so copy the module
+    // of shard to current context through bitcode
+    SmallVector<char, 0> buffer;
+    raw_svector_ostream os(buffer);
+    WriteBitcodeToFile(*shard.module_, os);
+    auto module = parseBitcodeFile(
+            MemoryBufferRef(StringRef(buffer.data(), buffer.size()), ""),
+            context_);
+    if (!module) {
+        errs() << toString(module.takeError()) << '\n';
         return false;
     }
-    // initialize target machine
-    TargetOptions opt;
-    auto rm = Optional<Reloc::Model>();
-    auto machine = target->createTargetMachine(target_tri,
-            "generic", "", opt, rm);
+    sizes_.insert(sizes_.end(), shard.sizes_.begin(), shard.sizes_.end());
+    return !Linker::linkModules(*module_, std::move(*module));
+}
+
+bool LLVMIRBuilder::CompileToObject(llvm::raw_pwrite_stream &os) {
+    using namespace llvm;
+    // initialize target triple and data layout
+    auto machine = CreateTargetMachine(size_level_, pic_);
+    if (!machine) return false;
+    module_->setTargetTriple(machine->getTargetTriple().str());
     module_->setDataLayout(machine->createDataLayout());
+    auto report = remarks_ && size_level_ != SizeLevel::None;
+    FunctionSizes sizes;
+    // optimize functions and generate code in parallel
+    if (jobs_ > 1) {
+        opt_.reset();
+        if (!EmitArchive(std::move(module_),
+                {jobs_, opt_budget_, size_level_, remarks_, pic_}, os,
+                report ? &sizes : nullptr)) {
+            return false;
+        }
+        if (report) ReportSizes(sizes);
+        return true;
+    }
+    if (report) {
+        AddFunctionSizes(*module_, sizes);
+        ReportSizes(sizes);
+    }
+    return EmitObject(*module_, *machine, os);
+}
+
+bool LLVMIRBuilder::CompileToObject(const char *file) {
+    using namespace llvm;
     // open object file
     std::error_code ec;
     raw_fd_ostream dest(file, ec, sys::fs::F_None);
@@ -97,155 +389,194 @@ bool LLVMIRBuilder::CompileToObject(const char *file) {
         return false;
     }
     // compile to object file
-    legacy::PassManager pass;
-    auto file_type = TargetMachine::CGFT_ObjectFile;
-    if (machine->addPassesToEmitFile(pass, dest, nullptr, file_type)) {
-        errs() << "target machine cannot emit file of this type\n";
-        return false;
-    }
-    pass.run(*module_);
+    if (!CompileToObject(dest)) return false;
     dest.flush();
     return true;
 }
 
-IRPtr LLVMIRBuilder::GenerateBlock(LazyIRGen consts, LazyIRGen vars,
+IRPtr LLVMIRBuilder::GenerateMainBlock(LazyIRGen consts, LazyIRGen vars,
         LazyIRGen proc_func, LazyIRGen stat) {
-    bool is_func_declare = !consts && !vars && !stat;
-    // generate procdures and functions first
-    proc_func();
-    // check if is body of function or procedure
-    if (!cur_func_.empty() && !is_func_declare) {
-        auto body = llvm::BasicBlock::Create(context_, "", cur_func_.top());
-        builder_.SetInsertPoint(body);
+    // create main function first,
+    // initializers of global variables will be generated in its entry
+    llvm::Function *func = nullptr;
+    if (vars || stat) {
+        func = CreateFunction("main", builder_.getInt32Ty(),
+                builder_.getInt32Ty(),
+                builder_.getInt8PtrTy()->getPointerTo());
+        // main function is never called by the program, so global
+        // variables only used in it can be its local variables
+        func->setDoesNotRecurse();
     }
     // generate constants and variables
     if (consts) consts();
     if (vars) vars();
-    // generate arguments and return value of function if necessary
-    if (!gen_func_args_.empty() && !is_func_declare) gen_func_args_.top()();
+    // generate procedures and functions,
+    // so that they can access all global constants and variables
+    proc_func();
+    // main function of shard is only used to initialize global variables
+    if (func && !has_main_) {
+        func->eraseFromParent();
+        func = nullptr;
+    }
     // generate statement
-    if (stat) {
-        // check if it's need to generate main function
-        if (cur_func_.empty()) {
-            auto func = CreateFunction("main",
-                    builder_.getInt32Ty(), builder_.getInt32Ty(),
-                    builder_.getInt8PtrTy()->getPointerTo());
-            cur_func_.push(func);
-            stat();
-            builder_.CreateRet(builder_.getInt32(0));
-            cur_func_.pop();
-            OptimizeFunction(func);
-        }
-        else {
-            stat();
-        }
+    if (func) {
+        builder_.SetInsertPoint(&func->back());
+        EnterFunction(func);
+        SealBlock(&func->back());
+        if (stat) stat();
+        builder_.CreateRet(builder_.getInt32(0));
+        ExitFunction();
+        PassCommandLineArgs(func);
+        OptimizeFunction(func);
+    }
+    return nullptr;
+}
+
+IRPtr LLVMIRBuilder::GenerateBlock(LazyIRGen consts, LazyIRGen vars,
+        LazyIRGen proc_func, LazyIRGen stat) {
+    if (cur_func_.empty()) {
+        return GenerateMainBlock(consts, vars, proc_func, stat);
     }
+    bool is_func_declare = !consts && !vars && !stat;
+    // generate constants, and then procedures and functions,
+    // so that they can refer to constants of current block,
+    // and the variables they capture by reference are known
+    if (consts) consts();
+    proc_func();
+    // check if is body of function or procedure
+    if (!is_func_declare) builder_.SetInsertPoint(CreateIsolatedBlock());
+    // generate arguments and return value of function if necessary,
+    // and then variables, which are initialized again by self tail calls
+    if (!gen_func_args_.empty() && !is_func_declare) gen_func_args_.top()();
+    if (vars) vars();
+    // generate statement
+    if (stat) stat();
     return nullptr;
 }
 
 IRPtr LLVMIRBuilder::GenerateConst(const std::string &id,
-        const IRPtr &expr) {
-    values_->AddValue(id, GetValue(expr));
+        const Binding &bind, const IRPtr &expr) {
+    values_.SetValue(bind, GetValue(expr));
     return nullptr;
 }
 
-IRPtr LLVMIRBuilder::GenerateVar(const std::string &id, const IRPtr &init) {
-    llvm::Value *var;
+IRPtr LLVMIRBuilder::GenerateVar(const std::string &id, const Binding &bind,
+        const IRPtr &init) {
     auto init_value = init ? GetValue(init) : builder_.getInt32(0);
     if (cur_func_.empty()) {
-        // create global variable
-        var = module_->getOrInsertGlobal(id, builder_.getInt32Ty());
+        // create global variable, it is only defined in the module which
+        // has main function, shards just declare it
+        auto var = new llvm::GlobalVariable(*module_, builder_.getInt32Ty(),
+                false, llvm::GlobalValue::ExternalLinkage, nullptr, id);
+        if (has_main_) {
+            // initial value that is not a constant (e.g. value of other
+            // variables) is stored at the start of main function
+            auto const_init = llvm::dyn_cast<llvm::Constant>(init_value);
+            var->setInitializer(const_init ? const_init
+                                           : builder_.getInt32(0));
+            if (!const_init) builder_.CreateStore(init_value, var);
+        }
+        values_.SetValue(bind, var);
     }
     else {
-        // create alloca
-        var = CreateAlloca(cur_func_.top());
+        // define local variable
+        DefineLocal(GetVar(bind), init_value);
     }
-    // generate store
-    builder_.CreateStore(init_value, var);
-    values_->AddValue(id, var);
     return nullptr;
 }
 
 IRPtr LLVMIRBuilder::GenerateProcedure(const std::string &id,
-        LazyIRGen block) {
-    // TODO: nested function!
+        const Binding &bind, const CaptureList &captures, LazyIRGen block) {
     // create function declaraction
-    auto func_type = llvm::FunctionType::get(builder_.getVoidTy(), false);
-    auto func = llvm::Function::Create(func_type,
-            llvm::Function::ExternalLinkage, NewFunName(id), module_.get());
+    auto func = DeclareFunction(id, builder_.getVoidTy(), 0, captures);
     // store information of current function
-    cur_func_.push(func);
-    values_->AddValue(id, func);
-    NewTable();
+    auto is_owned = IsBodyOwned();
+    EnterFunction(func);
+    values_.SetValue(bind, func);
+    values_.SetFunction(bind.depth + 1, func);
     // generate block
     bool is_declare = true;
-    gen_func_args_.push([&is_declare] {
+    auto gen_args = [this, func, &captures, &is_declare] {
+        GenerateCaptures(func, captures);
         is_declare = false;
         return nullptr;
-    });
-    block();
+    };
+    gen_func_args_.push(gen_args);
+    if (is_owned) block();
     // generate return statement
     if (!is_declare) builder_.CreateRetVoid();
     // remove current function info
-    cur_func_.pop();
-    RestoreTable();
+    ExitFunction();
+    gen_func_args_.pop();
     // do optimize
-    OptimizeFunction(func);
+    FinishFunction(func, is_declare);
     return nullptr;
 }
 
 IRPtr LLVMIRBuilder::GenerateFunction(const std::string &id,
-        const IdList &args, LazyIRGen block) {
-    // TODO: nested function!
+        const Binding &bind, const IdList &args, const CaptureList &captures,
+        LazyIRGen block) {
     // create function declaraction
-    std::vector<llvm::Type *> args_type(args.size(), builder_.getInt32Ty());
-    auto func_type = llvm::FunctionType::get(builder_.getInt32Ty(),
-            args_type, false);
-    auto func = llvm::Function::Create(func_type,
-            llvm::Function::ExternalLinkage, NewFunName(id), module_.get());
+    auto func = DeclareFunction(id, builder_.getInt32Ty(), args.size(),
+            captures);
     // store information of current function
-    cur_func_.push(func);
-    values_->AddValue(id, func);
-    NewTable();
+    auto is_owned = IsBodyOwned();
+    EnterFunction(func);
+    values_.SetValue(bind, func);
+    values_.SetFunction(bind.depth + 1, func);
     // generate arguments and return value
-    llvm::Value *ret = nullptr;
-    gen_func_args_.push([this, func, &args, &id, &ret] {
-        auto it = args.begin();
-        for (auto &&arg : func->args()) {
-            auto alloca = CreateAlloca(func);
-            builder_.CreateStore(&arg, alloca);
-            values_->AddValue(*it, alloca);
-            ++it;
+    // see 'Binding' for the layout of arguments scope
+    auto ret = GetVar({SymbolType::Ret, bind.depth + 1, 0});
+    bool is_declare = true;
+    auto gen_args = [this, func, &bind, &args, &captures, ret,
+            &is_declare] {
+        auto arg = func->arg_begin();
+        for (std::uint32_t i = 1; i <= args.size(); ++i) {
+            DefineLocal(GetVar({SymbolType::Var, bind.depth + 1, i}), arg++);
         }
-        ret = CreateAlloca(func);
-        builder_.CreateStore(builder_.getInt32(0), ret);
-        values_->AddValue(id + "_ret", ret);
+        DefineLocal(ret, builder_.getInt32(0));
+        GenerateCaptures(func, captures);
+        // target of self tail calls
+        auto body = llvm::BasicBlock::Create(context_, "", func);
+        builder_.CreateBr(body);
+        builder_.SetInsertPoint(body);
+        body_entry_.top() = body;
+        is_declare = false;
         return nullptr;
-    });
+    };
+    gen_func_args_.push(gen_args);
     // generate block
-    block();
+    if (is_owned) block();
     // generate return statement if not a function declare
-    if (ret) builder_.CreateRet(builder_.CreateLoad(ret));
+    if (!is_declare) {
+        SealBlock(body_entry_.top());
+        builder_.CreateRet(ReadLocal(ret));
+    }
     // remove current function info
-    cur_func_.pop();
-    RestoreTable();
+    ExitFunction();
     gen_func_args_.pop();
     // do optimize
-    OptimizeFunction(func);
+    FinishFunction(func, is_declare);
     return nullptr;
 }
 
-IRPtr LLVMIRBuilder::GenerateAssign(const std::string &id,
-        const IRPtr &expr, SymbolType type) {
-    llvm::Value *ptr = nullptr;
-    if (type == SymbolType::Ret) {
-        ptr = values_->GetValue(id + "_ret");
+IRPtr LLVMIRBuilder::GenerateAssign(const Binding &bind,
+        const IRPtr &expr, bool is_tail) {
+    // tail return of a call, the call must be the last instruction
+    auto call = llvm::dyn_cast<llvm::CallInst>(GetValue(expr));
+    if (is_tail && call && call == &builder_.GetInsertBlock()->back()
+            && GenerateTailCall(bind, call)) {
+        return nullptr;
+    }
+    // slot of 'Ret' is the return value
+    if (IsLocalVar(bind)) {
+        WriteLocal(GetVar(bind), GetValue(expr));
     }
     else {
-        ptr = values_->GetValue(id);
+        auto ptr = values_.GetValue(bind);
+        assert(ptr);
+        builder_.CreateStore(GetValue(expr), ptr);
     }
-    assert(ptr);
-    builder_.CreateStore(GetValue(expr), ptr);
     return nullptr;
 }
 
@@ -257,7 +588,9 @@ IRPtr LLVMIRBuilder::GenerateIf(const IRPtr &cond, LazyIRGen then,
     auto else_block = llvm::BasicBlock::Create(context_);
     auto merge_block = llvm::BasicBlock::Create(context_);
     // create conditional branch
-    builder_.CreateCondBr(GetValue(cond), then_block, else_block);
+    builder_.CreateCondBr(GetCondValue(cond), then_block, else_block);
+    SealBlock(then_block);
+    SealBlock(else_block);
     // emit 'then' block
     builder_.SetInsertPoint(then_block);
     if (then) then();
@@ -267,8 +600,9 @@ IRPtr LLVMIRBuilder::GenerateIf(const IRPtr &cond, LazyIRGen then,
     builder_.SetInsertPoint(else_block);
     if (else_then) else_then();
     builder_.CreateBr(merge_block);
-    // emit merge block
+    // emit merge block, all of its predecessors are known
     cur_func->getBasicBlockList().push_back(merge_block);
+    SealBlock(merge_block);
     builder_.SetInsertPoint(merge_block);
     return nullptr;
 }
@@ -283,17 +617,20 @@ IRPtr LLVMIRBuilder::GenerateWhile(LazyIRGen cond, LazyIRGen body) {
     break_cont_.push({end_block, cond_block});
     // create direct branch
     builder_.CreateBr(cond_block);
-    // emit 'cond' block
+    // emit 'cond' block, back edges are unknown until body is emitted
     builder_.SetInsertPoint(cond_block);
-    auto cond_expr = GetValue(cond());
+    auto cond_expr = GetCondValue(cond());
     builder_.CreateCondBr(cond_expr, body_block, end_block);
+    SealBlock(body_block);
     // emit 'body' block
     cur_func->getBasicBlockList().push_back(body_block);
     builder_.SetInsertPoint(body_block);
     if (body) body();
     builder_.CreateBr(cond_block);
-    // emit 'end' block
+    SealBlock(cond_block);
+    // emit 'end' block, all breaks are known
     cur_func->getBasicBlockList().push_back(end_block);
+    SealBlock(end_block);
     builder_.SetInsertPoint(end_block);
     // pop the top element of break/continue stack
     break_cont_.pop();
@@ -310,12 +647,16 @@ IRPtr LLVMIRBuilder::GenerateControl(Lexer::Keyword type) {
     assert(!break_cont_.empty());
     auto target = type == Lexer::Keyword::Break ?
             break_cont_.top().first : break_cont_.top().second;
-    return MakeIR(builder_.CreateBr(target));
+    auto br = builder_.CreateBr(target);
+    // statements after break/continue are unreachable
+    builder_.SetInsertPoint(CreateIsolatedBlock());
+    return MakeIR(br);
 }
 
 IRPtr LLVMIRBuilder::GenerateUnary(const IRPtr &operand) {
-    // 'odd' only
-    return MakeIR(builder_.CreateAnd(GetValue(operand), 1));
+    // 'odd' only, lowest bit as a condition like other comparisons
+    return MakeIR(builder_.CreateTrunc(GetValue(operand),
+            builder_.getInt1Ty()));
 }
 
 IRPtr LLVMIRBuilder::GenerateBinary(Lexer::Operator op,
@@ -344,29 +685,47 @@ IRPtr LLVMIRBuilder::GenerateBinary(Lexer::Operator op,
     return nullptr;
 }
 
-IRPtr LLVMIRBuilder::GenerateFunCall(const std::string &id,
+IRPtr LLVMIRBuilder::GenerateFunCall(const Binding &bind,
         const IRPtrList &args) {
-    // get function from module
-    auto callee = values_->GetValue(id);
+    // get function, 'Ret' refers to the function that owns its scope
+    llvm::Value *callee;
+    if (bind.type == SymbolType::Ret) {
+        callee = values_.GetFunction(bind.depth);
+    }
+    else {
+        callee = values_.GetValue(bind);
+    }
     assert(callee);
     // get value list
-    std::vector<llvm::Value *> values;
+    llvm::SmallVector<llvm::Value *, 8> values;
     for (const auto &i : args) {
         values.push_back(GetValue(i));
     }
+    // pass captured variables of nested procedures/functions
+    auto it = captures_.find(callee);
+    if (it != captures_.end()) {
+        for (const auto &i : it->second) {
+            auto var = GetVar(i.bind);
+            values.push_back(i.by_ref ? var_ptrs_.top().lookup(var)
+                                      : ReadLocal(var));
+        }
+    }
     // generate ir
     return MakeIR(builder_.CreateCall(callee, values));
 }
 
-IRPtr LLVMIRBuilder::GenerateId(const std::string &id, SymbolType type) {
-    if (type == SymbolType::Proc || type == SymbolType::Func
-            || type == SymbolType::Ret) {
-        return GenerateFunCall(id, {});
+IRPtr LLVMIRBuilder::GenerateId(const Binding &bind) {
+    if (bind.type == SymbolType::Proc || bind.type == SymbolType::Func
+            || bind.type == SymbolType::Ret) {
+        return GenerateFunCall(bind, {});
+    }
+    else if (IsLocalVar(bind)) {
+        return MakeIR(ReadLocal(GetVar(bind)));
     }
     else {
-        auto value = values_->GetValue(id);
+        auto value = values_.GetValue(bind);
         assert(value);
-        if (type == SymbolType::Var) value = builder_.CreateLoad(value);
+        if (bind.type == SymbolType::Var) value = builder_.CreateLoad(value);
         return MakeIR(value);
     }
 }
@@ -0,0 +1,240 @@
+#include <back/llvm/codegen.h>
+
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <cstddef>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/Object/ArchiveWriter.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Analysis/GlobalsModRef.h>
+#include <llvm/IR/OptBisect.h>
+#include <llvm/Pass.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+
+namespace {
+
+// skip whole-program function and loop passes of functions which are
+// downgraded to the cheaper pipelines, see 'RecordPipeline'
+class DowngradeGate : public llvm::OptPassGate {
+public:
+    DowngradeGate() : func_(nullptr) {}
+
+    bool shouldRunPass(const llvm::Pass *pass,
+            llvm::StringRef desc) override {
+        auto kind = pass->getPassKind();
+        if (kind != llvm::PT_Function && kind != llvm::PT_Loop) return true;
+        return !func_ || GetRecordedPipeline(*func_) == Pipeline::Full;
+    }
+    bool isEnabled() const override { return true; }
+
+    void set_func(const llvm::Function *func) { func_ = func; }
+
+private:
+    // function being optimized
+    const llvm::Function *func_;
+};
+
+// tell the gate which function is being optimized, it runs before
+// the other function and loop passes of every function
+class FunctionTracker : public llvm::FunctionPass {
+public:
+    static char ID;
+
+    FunctionTracker(DowngradeGate &gate) : FunctionPass(ID), gate_(gate) {}
+
+    bool runOnFunction(llvm::Function &func) override {
+        gate_.set_func(&func);
+        return false;
+    }
+    void getAnalysisUsage(llvm::AnalysisUsage &usage) const override {
+        usage.setPreservesAll();
+    }
+
+private:
+    DowngradeGate &gate_;
+};
+
+char FunctionTracker::ID = 0;
+
+} // namespace
+
+void OptimizeModule(llvm::Module &module, SizeLevel size_level) {
+    using namespace llvm;
+    DowngradeGate gate;
+    legacy::PassManager pass;
+    // make global variables constants or locals of main function,
+    // and remove unused ones
+    pass.add(createGlobalOptimizerPass());
+    // whole-program mod/ref of global variables,
+    // so that calls that never touch them are known
+    pass.add(createGlobalsAAWrapperPass());
+    pass.add(new FunctionTracker(gate));
+    // promote global variables accessed in loops to registers,
+    // then remove redundant loads of them
+    pass.add(createLICMPass());
+    pass.add(createGVNPass());
+    if (size_level != SizeLevel::None) {
+        // code generators of PL/0 programs produce many duplicates
+        pass.add(createMergeFunctionsPass());
+    }
+    if (size_level == SizeLevel::Smallest) {
+        // factor similar code regions of the rest out into functions
+        pass.add(createIROutlinerPass());
+    }
+    // apply the gate only to these passes
+    auto &context = module.getContext();
+    auto &last_gate = context.getOptPassGate();
+    context.setOptPassGate(gate);
+    pass.run(module);
+    context.setOptPassGate(last_gate);
+}
+
+std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(
+        SizeLevel size_level, bool pic) {
+    using namespace llvm;
+    // lookup target in target registry
+    std::string target_error;
+    auto target_tri = sys::getDefaultTargetTriple();
+    auto target = TargetRegistry::lookupTarget(target_tri, target_error);
+    if (!target) {
+        errs() << target_error << '\n';
+        return nullptr;
+    }
+    // initialize target machine
+    TargetOptions opt;
+    opt.FunctionSections = size_level != SizeLevel::None;
+    opt.DataSections = size_level != SizeLevel::None;
+    auto rm = pic ? Optional<Reloc::Model>(Reloc::PIC_)
+                  : Optional<Reloc::Model>();
+    return std::unique_ptr<TargetMachine>(target->createTargetMachine(
+            target_tri, "generic", "", opt, rm));
+}
+
+bool EmitObject(llvm::Module &module, llvm::TargetMachine &machine,
+        llvm::raw_pwrite_stream &os) {
+    using namespace llvm;
+    legacy::PassManager pass;
+    auto file_type = TargetMachine::CGFT_ObjectFile;
+    if (machine.addPassesToEmitFile(pass, os, nullptr, file_type)) {
+        errs() << "target machine cannot emit file of this type\n";
+        return false;
+    }
+    pass.run(module);
+    return true;
+}
+
+bool EmitArchive(std::unique_ptr<llvm::Module> module,
+        const CodegenOptions &opts, llvm::raw_ostream &os,
+        FunctionSizes *sizes) {
+    using namespace llvm;
+    Triple triple(module->getTargetTriple());
+    auto stem = sys::path::stem(module->getModuleIdentifier()).str();
+    // split module, serialize partitions in the context of module
+    std::vector<SmallVector<char, 0>> bitcodes;
+    auto write_part = [&](std::unique_ptr<Module> part) {
+        bitcodes.emplace_back();
+        raw_svector_ostream os(bitcodes.back());
+        WriteBitcodeToFile(*part, os);
+    };
+    SplitModule(std::move(module), opts.jobs, write_part);
+    // optimize and compile partitions in parallel
+    std::vector<SmallVector<char, 0>> objects(bitcodes.size());
+    // downgrades of functions in every partition
+    std::vector<std::vector<std::pair<std::string, std::string>>> downgrades(
+            bitcodes.size());
+    std::vector<FunctionSizes> part_sizes(bitcodes.size());
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&] {
+        for (auto i = next++; i < bitcodes.size(); i = next++) {
+            LLVMContext context;
+            auto part = parseBitcodeFile(MemoryBufferRef(
+                    StringRef(bitcodes[i].data(), bitcodes[i].size()), ""),
+                    context);
+            if (!part) {
+                consumeError(part.takeError());
+                failed = true;
+                continue;
+            }
+            FunctionOptimizer opt(part->get(), opts.opt_budget);
+            for (auto &&func : **part) {
+                if (func.isDeclaration()) continue;
+                auto message = opt.Run(func);
+                if (message.empty()) continue;
+                downgrades[i].push_back({func.getName().str(), message});
+            }
+            if (sizes) AddFunctionSizes(**part, part_sizes[i]);
+            auto machine = CreateTargetMachine(opts.size_level, opts.pic);
+            raw_svector_ostream os(objects[i]);
+            if (!machine || !EmitObject(**part, *machine, os)) failed = true;
+        }
+    };
+    // current thread is also a worker
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < bitcodes.size(); ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto &&i : threads) i.join();
+    if (opts.remarks) {
+        for (const auto &part : downgrades) {
+            for (const auto &i : part) PrintRemark(i.first, i.second);
+        }
+    }
+    if (sizes) {
+        for (const auto &i : part_sizes) sizes->insert(i.begin(), i.end());
+    }
+    if (failed) {
+        errs() << "could not compile module partitions\n";
+        return false;
+    }
+    // write all objects to archive
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+        names.push_back(stem + "." + std::to_string(i) + ".o");
+    }
+    std::vector<NewArchiveMember> members;
+    for (std::size_t i = 0; i < objects.size(); ++i) {
+        members.emplace_back(MemoryBufferRef(
+                StringRef(objects[i].data(), objects[i].size()), names[i]));
+    }
+    return WriteArchive(triple, members, os);
+}
+
+void PrintRemark(const std::string &func, const std::string &message) {
+    std::ostringstream oss;
+    oss << "\033[1mbuilder\033[0m (function: " << func;
+    oss << "): \033[32m\033[1mremark\033[0m: " << message << std::endl;
+    std::cerr << oss.str();
+}
+
+bool WriteArchive(const llvm::Triple &triple,
+        llvm::ArrayRef<llvm::NewArchiveMember> members,
+        llvm::raw_ostream &os) {
+    using namespace llvm;
+    auto kind = triple.isOSDarwin() ? object::Archive::K_DARWIN
+                                    : object::Archive::K_GNU;
+    auto buffer = writeArchiveToBuffer(members, true, kind, true, false);
+    if (!buffer) {
+        errs() << "could not write archive: ";
+        errs() << toString(buffer.takeError()) << "\n";
+        return false;
+    }
+    os << (*buffer)->getBuffer();
+    return true;
+}
@@ -0,0 +1,163 @@
+#include <back/llvm/escape.h>
+
+#include <vector>
+
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Module.h>
+
+namespace {
+
+// runtime function which accesses arrays/strings through handles
+// without keeping them, 'args' is the mask of handle arguments,
+// 'returns_handle' means the first handle argument is returned
+struct HandleUser {
+    const char *name;
+    unsigned int args;
+    bool returns_handle;
+};
+
+constexpr HandleUser kHandleUsers[] = {
+    {"freearray", 1, false},     {"getarraypos", 1, false},
+    {"setarraypos", 1, false},   {"arrayfront", 1, false},
+    {"arrayback", 1, false},     {"arrayempty", 1, false},
+    {"arraylen", 1, false},      {"arraycapacity", 1, false},
+    {"arrayclear", 1, false},    {"arraypush", 1, false},
+    {"arraypop", 1, false},      {"arrayresize", 1, false},
+    {"freestring", 1, false},    {"getstringpos", 1, false},
+    {"setstringpos", 1, false},  {"stringlen", 1, false},
+    {"stringmemlen", 1, false},  {"stringadd", 3, false},
+    {"stringconcat", 3, true},   {"stringcompare", 3, false},
+    {"stringassign", 3, true},   {"stringtoint", 1, false},
+    {"stringtoreal", 1, false},  {"print", 1, false},
+    {"println", 1, false},       {"open", 3, false},
+    {"readfile", 2, false},      {"writefile", 2, false},
+    {"readstring", 2, false},    {"writestring", 2, false},
+};
+
+const HandleUser *GetHandleUser(const llvm::Function *callee) {
+    if (!callee || !callee->isDeclaration()) return nullptr;
+    for (const auto &i : kHandleUsers) {
+        if (callee->getName() == i.name) return &i;
+    }
+    return nullptr;
+}
+
+// get the name of local allocator if 'call' creates an array/string
+const char *GetLocalAllocator(const llvm::CallInst *call) {
+    auto callee = call->getCalledFunction();
+    if (!callee || !callee->isDeclaration()) return nullptr;
+    if (callee->getName() == "newarray") return "NewLocalArray";
+    if (callee->getName() == "newstring") return "NewLocalString";
+    return nullptr;
+}
+
+// check if handle created by 'alloc' escapes from its function
+bool IsEscaped(llvm::CallInst *alloc) {
+    using namespace llvm;
+    SmallVector<Value *, 8> values = {alloc};
+    SmallPtrSet<Value *, 8> visited = {alloc};
+    auto follow = [&](Value *value) {
+        if (visited.insert(value).second) values.push_back(value);
+    };
+    while (!values.empty()) {
+        auto value = values.pop_back_val();
+        for (auto user : value->users()) {
+            if (isa<PHINode>(user)) {
+                follow(user);
+            }
+            else if (auto cmp = dyn_cast<ICmpInst>(user)) {
+                // handles in arena have different values (negative),
+                // only equality with other handles is still the same
+                if (!cmp->isEquality() || isa<Constant>(cmp->getOperand(0))
+                        || isa<Constant>(cmp->getOperand(1))) {
+                    return true;
+                }
+            }
+            else if (auto sel = dyn_cast<SelectInst>(user)) {
+                // used as condition is fine
+                if (sel->getCondition() != value) follow(sel);
+            }
+            else if (auto call = dyn_cast<CallInst>(user)) {
+                auto handle_user = GetHandleUser(call->getCalledFunction());
+                if (!handle_user) return true;
+                unsigned int index = 0;
+                for (const auto &arg : call->args()) {
+                    if (arg == value && !(handle_user->args & (1u << index))) {
+                        return true;
+                    }
+                    ++index;
+                }
+                if (handle_user->returns_handle) follow(call);
+            }
+            else {
+                // stores, returns, arithmetic and so on
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+llvm::Function *GetRuntimeFunction(llvm::Module &module, const char *name,
+        llvm::FunctionType *type) {
+    auto callee = module.getOrInsertFunction(name, type).getCallee();
+    auto func = llvm::cast<llvm::Function>(callee);
+    func->setDoesNotThrow();
+    return func;
+}
+
+} // namespace
+
+std::size_t AllocateInFrame(llvm::Function &func) {
+    using namespace llvm;
+    if (func.isDeclaration()) return 0;
+    // find arrays/strings that never escape
+    std::vector<CallInst *> allocs;
+    for (auto &inst : instructions(func)) {
+        auto call = dyn_cast<CallInst>(&inst);
+        if (call && GetLocalAllocator(call) && !IsEscaped(call)) {
+            allocs.push_back(call);
+        }
+    }
+    if (allocs.empty()) return 0;
+    // redirect them to local allocators, which have the same prototypes
+    auto &module = *func.getParent();
+    for (const auto &call : allocs) {
+        auto type = call->getFunctionType();
+        auto local = GetRuntimeFunction(module, GetLocalAllocator(call),
+                type);
+        call->setCalledFunction(type, local);
+    }
+    // mark arena after stack slots in entry block
+    IRBuilder<> builder(module.getContext());
+    auto int_ty = builder.getInt32Ty();
+    auto enter = GetRuntimeFunction(module, "EnterFrame",
+            FunctionType::get(int_ty, false));
+    auto leave = GetRuntimeFunction(module, "LeaveFrame",
+            FunctionType::get(builder.getVoidTy(), {int_ty}, false));
+    enter->setOnlyAccessesInaccessibleMemory();
+    leave->setOnlyAccessesInaccessibleMemory();
+    auto &entry = func.getEntryBlock();
+    auto pos = entry.getFirstInsertionPt();
+    while (isa<AllocaInst>(*pos)) ++pos;
+    builder.SetInsertPoint(&entry, pos);
+    auto frame = builder.CreateCall(enter);
+    // release arena before leaving function, handles are never
+    // passed to callees, so 'musttail' calls can come after it
+    for (auto &block : func) {
+        auto ret = dyn_cast<ReturnInst>(block.getTerminator());
+        if (!ret) continue;
+        Instruction *inst = ret;
+        if (auto prev = ret->getPrevNode()) {
+            auto call = dyn_cast<CallInst>(prev);
+            if (call && call->isMustTailCall()) inst = call;
+        }
+        builder.SetInsertPoint(inst);
+        builder.CreateCall(leave, {frame});
+    }
+    return allocs.size();
+}
@@ -0,0 +1,193 @@
+#include <back/llvm/incremental.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+#include <llvm/ADT/Triple.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <define/astcache.h>
+#include <back/llvm/builder.h>
+#include <back/llvm/codegen.h>
+
+namespace {
+
+using NodeId = FlatAST::NodeId;
+using Kind = FlatAST::Kind;
+
+// object that contains a top level procedure/function or main function
+struct Unit {
+    // top level procedures/functions to generate in program order,
+    // only the last one is defined if it is not the main object
+    std::vector<NodeId> funcs;
+    bool has_main;
+    std::string path;
+};
+
+// path of cached object, the hash also covers the options which
+// change the generated code and the compiler version
+std::string GetObjectPath(const char *dir, const std::string &key,
+        const std::string &flags) {
+    char name[17];
+    auto hash = HashSource(key + ";" + flags + ";" APP_VERSION);
+    std::snprintf(name, sizeof(name), "%016llx",
+            static_cast<unsigned long long>(hash));
+    return std::string(dir) + "/" + name + ".o";
+}
+
+std::string GetKey(const FlatAST &ast, NodeId id, std::uint32_t depth) {
+    if (id == FlatAST::kNullNode) return "";
+    return std::to_string(HashSubtree(ast, id, depth));
+}
+
+// check if procedure/function only declares an external function
+bool IsDeclaration(const FlatAST &ast, NodeId id) {
+    auto block = ast.child(id, 0);
+    for (std::size_t i = 0; i < 3; ++i) {
+        if (ast.child(block, i) != FlatAST::kNullNode) return false;
+    }
+    return true;
+}
+
+std::vector<Unit> GetUnits(const FlatAST &ast, const char *dir,
+        const std::string &flags) {
+    auto c = ast.children(ast.root());
+    std::vector<Unit> units;
+    // used top level procedures/functions, binding key to index
+    std::unordered_map<std::uint64_t, std::size_t> top_ids;
+    std::uint32_t depth = 0;
+    std::vector<NodeId> funcs;
+    for (std::size_t i = 3; i < c.size(); ++i) {
+        if (!ast.is_used(c[i])) continue;
+        const auto &bind = ast.binding(c[i]);
+        depth = bind.depth;
+        top_ids[GetBindingKey(bind)] = funcs.size();
+        funcs.push_back(c[i]);
+    }
+    // main function and global variables
+    auto key = "main;" + GetKey(ast, c[0], depth) + ";"
+            + GetKey(ast, c[1], depth) + ";" + GetKey(ast, c[2], depth);
+    units.push_back({funcs, true, GetObjectPath(dir, key, flags)});
+    // every procedure/function with its callees declared before it
+    for (std::size_t i = 0; i < funcs.size(); ++i) {
+        if (IsDeclaration(ast, funcs[i])) continue;
+        std::vector<bool> called(funcs.size(), false);
+        ast.Traverse(funcs[i], [&](NodeId id) {
+            auto kind = ast.kind(id);
+            const auto &bind = ast.binding(id);
+            if ((kind == Kind::FunCall || kind == Kind::Id)
+                    && (bind.type == SymbolType::Proc
+                        || bind.type == SymbolType::Func)) {
+                auto it = top_ids.find(GetBindingKey(bind));
+                if (it != top_ids.end()) called[it->second] = true;
+            }
+            return true;
+        });
+        Unit unit = {{}, false,
+                GetObjectPath(dir, GetKey(ast, funcs[i], depth), flags)};
+        for (std::size_t j = 0; j < i; ++j) {
+            if (called[j]) unit.funcs.push_back(funcs[j]);
+        }
+        unit.funcs.push_back(funcs[i]);
+        units.push_back(std::move(unit));
+    }
+    return units;
+}
+
+void GenerateUnit(const FlatAST &ast, const Unit &unit, LLVMIRBuilder &irb) {
+    auto c = ast.children(ast.root());
+    auto consts = [&] { return ast.GenerateIR(irb, c[0]); };
+    auto vars = [&] { return ast.GenerateIR(irb, c[1]); };
+    auto stat = [&] { return ast.GenerateIR(irb, c[2]); };
+    auto count = unit.funcs.size();
+    auto has_main = unit.has_main;
+    irb.SetShard(has_main, [has_main, count](std::size_t i) {
+        return !has_main && i + 1 == count;
+    });
+    irb.GenerateBlock(
+            c[0] != FlatAST::kNullNode ? LazyIRGen(consts) : nullptr,
+            c[1] != FlatAST::kNullNode ? LazyIRGen(vars) : nullptr, [&] {
+                for (const auto &i : unit.funcs) ast.GenerateIR(irb, i);
+                return nullptr;
+            },
+            has_main && c[2] != FlatAST::kNullNode ? LazyIRGen(stat)
+                                                   : nullptr);
+}
+
+} // namespace
+
+bool CompileIncremental(const FlatAST &ast, const char *dir,
+        llvm::raw_ostream &os, unsigned int jobs, const BuilderInit &init) {
+    using namespace llvm;
+    if (auto ec = sys::fs::create_directories(dir)) {
+        errs() << "could not create directory '" << dir << "': ";
+        errs() << ec.message() << "\n";
+        return false;
+    }
+    // get options from a builder initialized by 'init'
+    LLVMIRBuilder config("");
+    init(config);
+    auto flags = std::to_string(static_cast<int>(config.size_level()))
+            + (config.pic() ? ";pic" : "");
+    auto units = GetUnits(ast, dir, flags);
+    // create builders of stale objects in current thread,
+    // since initialization of LLVM target registry is not thread safe
+    std::vector<const Unit *> stale;
+    std::vector<std::unique_ptr<LLVMIRBuilder>> builders;
+    for (const auto &unit : units) {
+        if (sys::fs::exists(unit.path)) continue;
+        stale.push_back(&unit);
+        builders.push_back(std::make_unique<LLVMIRBuilder>(""));
+        init(*builders.back());
+    }
+    // compile stale objects, write to temporary files first,
+    // so that other compilers never see partial objects
+    auto tmp_suffix = ".tmp" + std::to_string(sys::Process::getProcessId());
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+    auto worker = [&] {
+        for (auto i = next++; i < stale.size(); i = next++) {
+            auto &irb = *builders[i];
+            GenerateUnit(ast, *stale[i], irb);
+            auto tmp = stale[i]->path + tmp_suffix;
+            if (!irb.CompileToObject(tmp.c_str())
+                    || sys::fs::rename(tmp, stale[i]->path)) {
+                failed = true;
+            }
+            builders[i].reset();
+        }
+    };
+    // current thread is also a worker
+    jobs = std::max<std::size_t>(std::min<std::size_t>(jobs, stale.size()), 1);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < jobs; ++i) threads.emplace_back(worker);
+    worker();
+    for (auto &&i : threads) i.join();
+    if (failed) {
+        errs() << "could not compile objects in '" << dir << "'\n";
+        return false;
+    }
+    // write all objects to archive
+    std::vector<NewArchiveMember> members;
+    for (const auto &unit : units) {
+        auto member = NewArchiveMember::getFile(unit.path, true);
+        if (!member) {
+            errs() << "could not read file '" << unit.path << "': ";
+            errs() << toString(member.takeError()) << "\n";
+            return false;
+        }
+        members.push_back(std::move(*member));
+    }
+    return WriteArchive(Triple(sys::getDefaultTargetTriple()), members, os);
+}
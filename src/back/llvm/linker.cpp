@@ -0,0 +1,114 @@
+#include <back/llvm/linker.h>
+
+#include <vector>
+#include <cstdlib>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/raw_ostream.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+// input file of linker which holds the object
+class InputFile {
+public:
+    InputFile() : fd_(-1) {}
+    ~InputFile() {
+        if (fd_ < 0) return;
+        llvm::sys::Process::SafelyCloseFileDescriptor(fd_);
+#ifndef __linux__
+        llvm::sys::fs::remove(path_);
+#endif
+    }
+
+    // create file and write 'object' to it
+    bool Create(llvm::StringRef object) {
+#ifdef __linux__
+        // file descriptor is inherited by linker
+        fd_ = memfd_create("pl01", 0);
+        if (fd_ < 0) return false;
+        path_ = "/dev/fd/" + std::to_string(fd_);
+#else
+        llvm::SmallString<128> path;
+        if (llvm::sys::fs::createTemporaryFile("pl01", "o", fd_, path)) {
+            return false;
+        }
+        path_ = path.str().str();
+#endif
+        llvm::raw_fd_ostream os(fd_, false);
+        os << object;
+        os.flush();
+        return !os.has_error();
+    }
+
+    const std::string &path() const { return path_; }
+
+private:
+    int fd_;
+    std::string path_;
+};
+
+} // namespace
+
+bool LinkExecutable(llvm::StringRef object, const std::string &runtime,
+        const std::string &file, LinkMode mode, SizeLevel size_level) {
+    using namespace llvm;
+    // find compiler driver and runtime library
+    const char *name = std::getenv("PL01_CC");
+    if (!name) name = "cc";
+    auto cc = sys::findProgramByName(name);
+    if (!cc) {
+        errs() << "could not find linker '" << name << "': ";
+        errs() << cc.getError().message() << "\n";
+        return false;
+    }
+    if (!sys::fs::exists(runtime)) {
+        errs() << "could not find runtime library '" << runtime << "'\n";
+        return false;
+    }
+    // write object
+    InputFile input;
+    if (!input.Create(object)) {
+        errs() << "could not create input file of linker\n";
+        return false;
+    }
+    // link, objects are not position independent except in static-PIE
+    std::vector<StringRef> args = {*cc};
+    switch (mode) {
+        case LinkMode::Dynamic: {
+#ifdef __linux__
+            args.push_back("-no-pie");
+#endif
+            break;
+        }
+        case LinkMode::Static: args.push_back("-static"); break;
+        case LinkMode::StaticPIE: args.push_back("-static-pie"); break;
+    }
+    // every function has its own section, see 'CreateTargetMachine'
+    if (size_level != SizeLevel::None) args.push_back("-Wl,--gc-sections");
+    args.insert(args.end(), {"-o", file, input.path(), runtime, "-lm"});
+    std::string error;
+    if (sys::ExecuteAndWait(*cc, args, None, {}, 0, 0, &error)) {
+        errs() << "could not link executable '" << file << "'";
+        if (!error.empty()) errs() << ": " << error;
+        errs() << "\n";
+        return false;
+    }
+    return true;
+}
+
+std::string GetDefaultRuntime(const char *argv0) {
+    auto addr = reinterpret_cast<void *>(&GetDefaultRuntime);
+    auto exe = llvm::sys::fs::getMainExecutable(argv0, addr);
+    llvm::SmallString<128> path(llvm::sys::path::parent_path(exe));
+    llvm::sys::path::append(path, "libpl01rt.a");
+    return path.str().str();
+}
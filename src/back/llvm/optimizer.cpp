@@ -0,0 +1,164 @@
+#include <back/llvm/optimizer.h>
+
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+
+#include <llvm/IR/Attributes.h>
+#include <llvm/Transforms/InstCombine/InstCombine.h>
+#include <llvm/Transforms/Scalar.h>
+#include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Transforms/Utils.h>
+
+namespace {
+
+// thresholds of full pipeline
+constexpr std::size_t kMaxFullInsts = 20000;
+constexpr std::size_t kMaxFullBlocks = 2000;
+constexpr std::size_t kMaxFullMemOps = 5000;
+// thresholds of cheap pipeline, instruction selection is also
+// superlinear in the size of basic blocks
+constexpr std::size_t kMaxCheapInsts = 100000;
+constexpr std::size_t kMaxCheapBlocks = 10000;
+constexpr std::size_t kMaxCheapBlockSize = 10000;
+
+// function attribute of recorded pipeline
+constexpr char kPipelineAttr[] = "pl01-pipeline";
+
+const char *GetPipelineName(Pipeline pipeline) {
+    switch (pipeline) {
+        case Pipeline::Full: return "full";
+        case Pipeline::Cheap: return "cheap";
+        default: return "minimal";
+    }
+}
+
+} // namespace
+
+Pipeline GetPipeline(const llvm::Function &func, std::string *reason) {
+    // memory accesses (including calls) are what make
+    // memory dependence analysis of GVN expensive
+    std::size_t insts = 0, mem_ops = 0, max_block = 0;
+    for (const auto &block : func) {
+        for (const auto &inst : block) {
+            if (inst.mayReadOrWriteMemory()) ++mem_ops;
+        }
+        insts += block.size();
+        max_block = std::max(max_block, block.size());
+    }
+    auto blocks = func.size();
+    auto pipeline = Pipeline::Full;
+    if (insts > kMaxCheapInsts || blocks > kMaxCheapBlocks
+            || max_block > kMaxCheapBlockSize) {
+        pipeline = Pipeline::Minimal;
+    }
+    else if (insts > kMaxFullInsts || blocks > kMaxFullBlocks
+            || mem_ops > kMaxFullMemOps) {
+        pipeline = Pipeline::Cheap;
+    }
+    if (reason && pipeline != Pipeline::Full) {
+        std::ostringstream oss;
+        oss << insts << " instructions, " << blocks << " blocks, ";
+        oss << "largest block " << max_block << ", " << mem_ops;
+        oss << " memory accesses";
+        *reason = oss.str();
+    }
+    return pipeline;
+}
+
+std::string RecordPipeline(llvm::Function &func) {
+    std::string reason;
+    auto pipeline = GetPipeline(func, &reason);
+    func.addFnAttr(kPipelineAttr, GetPipelineName(pipeline));
+    if (pipeline == Pipeline::Full) return "";
+    std::ostringstream oss;
+    oss << "downgraded to " << GetPipelineName(pipeline);
+    oss << " pipeline (" << reason << ")";
+    return oss.str();
+}
+
+bool HasRecordedPipeline(const llvm::Function &func) {
+    return func.hasFnAttribute(kPipelineAttr);
+}
+
+Pipeline GetRecordedPipeline(const llvm::Function &func) {
+    auto name = func.getFnAttribute(kPipelineAttr).getValueAsString();
+    if (name == GetPipelineName(Pipeline::Cheap)) return Pipeline::Cheap;
+    if (name == GetPipelineName(Pipeline::Minimal)) return Pipeline::Minimal;
+    return Pipeline::Full;
+}
+
+FunctionOptimizer::FunctionOptimizer(llvm::Module *module,
+        unsigned int budget)
+        : module_(module), budget_(budget) {
+    using namespace llvm;
+    // local variables are already in SSA form, see 'SSABuilder'
+    // peephole optimizations
+    AddStage(full_, "instcombine", {createInstructionCombiningPass()});
+    // reassociate expressions
+    AddStage(full_, "reassociate", {createReassociatePass()});
+    // eliminate common sub-expressions
+    // calls to procedures/functions without side effects included
+    AddStage(full_, "gvn", {createGVNPass()});
+    // hoist loop invariants out of rotated loops
+    AddStage(full_, "licm", {createLoopRotatePass(), createLICMPass()});
+    // simplify the control flow graph
+    AddStage(full_, "simplifycfg", {createCFGSimplificationPass()});
+    // linear time only
+    AddStage(cheap_, "early-cse", {createEarlyCSEPass()});
+    AddStage(cheap_, "simplifycfg", {createCFGSimplificationPass()});
+    AddStage(minimal_, "simplifycfg", {createCFGSimplificationPass()});
+}
+
+void FunctionOptimizer::AddStage(std::vector<Stage> &stages,
+        const char *name, std::vector<llvm::Pass *> passes) {
+    auto fpm = std::make_unique<llvm::legacy::FunctionPassManager>(module_);
+    for (const auto &pass : passes) fpm->add(pass);
+    fpm->doInitialization();
+    stages.push_back({name, std::move(fpm)});
+}
+
+std::string FunctionOptimizer::Run(llvm::Function &func) {
+    using Clock = std::chrono::steady_clock;
+    std::ostringstream oss;
+    if (!HasRecordedPipeline(func)) oss << RecordPipeline(func);
+    auto pipeline = GetRecordedPipeline(func);
+    const auto &stages = pipeline == Pipeline::Full    ? full_
+                       : pipeline == Pipeline::Cheap ? cheap_
+                                                     : minimal_;
+    // run stages until budget is exhausted
+    auto start = Clock::now();
+    for (auto it = stages.begin(); it != stages.end(); ++it) {
+        it->second->run(func);
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                Clock::now() - start).count();
+        if (budget_ && elapsed >= budget_ && it + 1 != stages.end()) {
+            if (oss.tellp() > 0) oss << ", ";
+            oss << "optimization stopped after '" << it->first << "' (";
+            oss << elapsed << " ms, budget " << budget_ << " ms)";
+            break;
+        }
+    }
+    // functions downgraded to the minimal pipeline are not optimized
+    // by other passes (including code generation) either
+    if (pipeline == Pipeline::Minimal) {
+        func.removeFnAttr(llvm::Attribute::OptimizeForSize);
+        func.removeFnAttr(llvm::Attribute::MinSize);
+        func.addFnAttr(llvm::Attribute::NoInline);
+        func.addFnAttr(llvm::Attribute::OptimizeNone);
+    }
+    return oss.str();
+}
+
+void SetSizeLevel(llvm::Function &func, SizeLevel level) {
+    if (level == SizeLevel::None) return;
+    func.addFnAttr(llvm::Attribute::OptimizeForSize);
+    if (level == SizeLevel::Smallest) func.addFnAttr(llvm::Attribute::MinSize);
+}
+
+void AddFunctionSizes(const llvm::Module &module, FunctionSizes &sizes) {
+    for (const auto &func : module) {
+        if (func.isDeclaration()) continue;
+        sizes[func.getName().str()] = func.getInstructionCount();
+    }
+}
@@ -0,0 +1,125 @@
+#include <back/llvm/parallel.h>
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <sstream>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <cstddef>
+
+namespace {
+
+// generate the whole program, 'stat' may be empty
+IRPtr GenerateProgram(BlockAST &program, LLVMIRBuilder &irb,
+        LazyIRGen stat) {
+    auto consts = [&] { return program.consts()->GenerateIR(irb); };
+    auto vars = [&] { return program.vars()->GenerateIR(irb); };
+    return irb.GenerateBlock(
+            program.consts() ? LazyIRGen(consts) : nullptr,
+            program.vars() ? LazyIRGen(vars) : nullptr, [&] {
+                for (const auto &i : program.proc_func()) i->GenerateIR(irb);
+                return nullptr;
+            }, stat);
+}
+
+// run 'worker' with indices [0, jobs) in threads, wait for all of them
+void RunWorkers(unsigned int jobs,
+        const std::function<void(unsigned int)> &worker) {
+    std::vector<std::thread> threads;
+    for (unsigned int k = 0; k < jobs; ++k) threads.emplace_back(worker, k);
+    for (auto &&i : threads) i.join();
+}
+
+// analyze procedures/functions in parallel, returns false if failed
+// error messages are discarded
+bool AnalyzeParallel(BlockAST &program, unsigned int jobs) {
+    const auto &proc_func = program.proc_func();
+    // declare all symbols of main block
+    // record the count of symbols visible to each procedure/function
+    std::ostringstream err;
+    Analyzer ana(err);
+    std::vector<std::size_t> visible;
+    ana.NewEnvironment();
+    if ((program.consts() && program.consts()->SemaAnalyze(ana)
+                == SymbolType::Error)
+            || (program.vars() && program.vars()->SemaAnalyze(ana)
+                == SymbolType::Error)) {
+        return false;
+    }
+    for (const auto &i : proc_func) {
+        if (i->SemaDeclare(ana) == SymbolType::Error) return false;
+        visible.push_back(ana.symbols().def_count());
+    }
+    // analyze bodies, each procedure/function has its own analyzer
+    std::vector<std::unique_ptr<Analyzer>> anas(proc_func.size());
+    std::vector<std::ostringstream> errs(proc_func.size());
+    std::atomic<bool> failed(false);
+    RunWorkers(jobs, [&](unsigned int k) {
+        for (auto i = k; i < proc_func.size(); i += jobs) {
+            anas[i] = std::make_unique<Analyzer>(ana, visible[i], errs[i]);
+            if (proc_func[i]->SemaAnalyzeBody(*anas[i])
+                    == SymbolType::Error) {
+                failed = true;
+            }
+        }
+    });
+    if (failed) return false;
+    // analyze main statement, then find reachable procedures/functions
+    for (const auto &i : anas) ana.MergeUses(*i);
+    ana.set_reachable(true);
+    if (program.stat() && program.stat()->SemaAnalyze(ana)
+            == SymbolType::Error) {
+        return false;
+    }
+    if (ana.error_num()) return false;
+    ana.ResolveUses();
+    return true;
+}
+
+} // namespace
+
+bool CompileParallel(BlockAST &program, LLVMIRBuilder &irb,
+        unsigned int jobs) {
+    const auto &proc_func = program.proc_func();
+    if (jobs > proc_func.size()) jobs = proc_func.size();
+    // analyze the program again in order if failed, since some calls
+    // (e.g. in initializers of constants) can only be evaluated in order,
+    // errors are also reported by it
+    if (!AnalyzeParallel(program, jobs)) {
+        Analyzer ana;
+        if (program.SemaAnalyze(ana) == SymbolType::Error
+                || ana.error_num()) {
+            return false;
+        }
+    }
+    // create shards in current thread,
+    // since initialization of LLVM target registry is not thread safe
+    std::vector<std::unique_ptr<LLVMIRBuilder>> shards;
+    for (unsigned int k = 0; k < jobs; ++k) {
+        shards.push_back(std::make_unique<LLVMIRBuilder>(""));
+        // functions will be optimized together with the main module
+        shards.back()->set_jobs(irb.jobs());
+        shards.back()->set_opt_budget(irb.opt_budget());
+        shards.back()->set_size_level(irb.size_level());
+        shards.back()->set_remarks(irb.remarks());
+        shards.back()->set_pic(irb.pic());
+        shards.back()->SetShard(false, [k, jobs](std::size_t i) {
+            return i % jobs == k;
+        });
+    }
+    // compile procedures/functions
+    RunWorkers(jobs, [&](unsigned int k) {
+        GenerateProgram(program, *shards[k], nullptr);
+    });
+    // generate main function, then link all shards
+    irb.SetShard(true, [](std::size_t) { return false; });
+    GenerateProgram(program, irb, [&] {
+        return program.stat() ? program.stat()->GenerateIR(irb) : nullptr;
+    });
+    for (const auto &i : shards) {
+        if (!irb.LinkModule(*i)) return false;
+    }
+    return true;
+}
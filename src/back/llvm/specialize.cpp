@@ -0,0 +1,172 @@
+#include <back/llvm/specialize.h>
+
+#include <map>
+#include <algorithm>
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+
+namespace {
+
+// limits of cost model
+constexpr std::size_t kMaxSize = 256;
+constexpr std::size_t kMaxClones = 4;
+
+using ArgList = std::vector<std::pair<unsigned int, int>>;
+
+// call sites of a callee with the same constant arguments
+struct Candidate {
+    llvm::Function *func;
+    ArgList args;
+    std::size_t benefit, cost;
+};
+
+// get constant arguments of a call
+ArgList GetConstArgs(const llvm::CallInst *call) {
+    ArgList args;
+    unsigned int index = 0;
+    for (const auto &i : call->args()) {
+        if (auto arg = llvm::dyn_cast<llvm::ConstantInt>(i)) {
+            args.push_back({index, static_cast<int>(arg->getSExtValue())});
+        }
+        ++index;
+    }
+    return args;
+}
+
+// get all direct calls of 'func', return false if it is used otherwise
+bool GetCalls(llvm::Function &func, std::vector<llvm::CallInst *> &calls) {
+    for (auto user : func.users()) {
+        auto call = llvm::dyn_cast<llvm::CallInst>(user);
+        if (!call || call->getCalledFunction() != &func) return false;
+        calls.push_back(call);
+    }
+    return true;
+}
+
+// check if 'func' can be cloned with a different prototype,
+// callers and callees of 'musttail' calls must keep their prototypes
+bool CanSpecialize(llvm::Function &func) {
+    if (func.isDeclaration() || !func.hasLocalLinkage()) return false;
+    if (func.getInstructionCount() > kMaxSize) return false;
+    for (const auto &inst : llvm::instructions(func)) {
+        auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+        if (call && call->isMustTailCall()) return false;
+    }
+    return true;
+}
+
+std::size_t GetBenefit(llvm::Function &func, const ArgList &args) {
+    std::size_t benefit = 0;
+    for (const auto &i : args) {
+        auto arg = func.arg_begin() + i.first;
+        for (auto user : arg->users()) {
+            benefit += llvm::isa<llvm::CmpInst>(user) ? 2 : 1;
+        }
+    }
+    return benefit;
+}
+
+// collect call sites of 'func' with constant arguments
+void AddCandidates(llvm::Function &func, std::vector<Candidate> &cands) {
+    std::vector<llvm::CallInst *> calls;
+    if (!CanSpecialize(func) || !GetCalls(func, calls)) return;
+    std::map<ArgList, std::vector<llvm::CallInst *>> groups;
+    for (const auto &call : calls) {
+        if (call->isMustTailCall()) continue;
+        auto args = GetConstArgs(call);
+        if (!args.empty()) groups[std::move(args)].push_back(call);
+    }
+    for (auto &&i : groups) {
+        auto benefit = GetBenefit(func, i.first) * i.second.size();
+        if (!benefit) continue;
+        auto cost = i.second.size() == calls.size()
+                ? 0 : func.getInstructionCount();
+        cands.push_back({&func, i.first, benefit, cost});
+    }
+}
+
+llvm::Function *CloneWithArgs(llvm::Function &func, const ArgList &args) {
+    llvm::ValueToValueMapTy vmap;
+    for (const auto &i : args) {
+        auto arg = func.arg_begin() + i.first;
+        vmap[arg] = llvm::ConstantInt::get(arg->getType(), i.second, true);
+    }
+    // mapped arguments are removed from the prototype of clone
+    auto clone = llvm::CloneFunction(&func, vmap);
+    clone->setName(func.getName() + ".spec");
+    return clone;
+}
+
+// replace call with the call to 'clone', drop constant arguments
+void Redirect(llvm::CallInst *call, llvm::Function *clone,
+        const ArgList &args) {
+    std::vector<llvm::Value *> new_args;
+    auto it = args.begin();
+    unsigned int index = 0;
+    for (const auto &i : call->args()) {
+        if (it != args.end() && it->first == index) {
+            ++it;
+        }
+        else {
+            new_args.push_back(i);
+        }
+        ++index;
+    }
+    auto new_call = llvm::CallInst::Create(clone, new_args, "", call);
+    new_call->setCallingConv(call->getCallingConv());
+    new_call->setTailCallKind(call->getTailCallKind());
+    new_call->takeName(call);
+    call->replaceAllUsesWith(new_call);
+    call->eraseFromParent();
+}
+
+} // namespace
+
+std::vector<Specialization> SpecializeFunctions(llvm::Module &module) {
+    // collect candidates in module order
+    std::vector<Candidate> cands;
+    std::size_t size = 0;
+    for (auto &func : module) {
+        size += func.getInstructionCount();
+        AddCandidates(func, cands);
+    }
+    // the most profitable groups first
+    std::stable_sort(cands.begin(), cands.end(),
+            [](const Candidate &l, const Candidate &r) {
+                return l.benefit * r.cost > r.benefit * l.cost;
+            });
+    // clone callees within the budget
+    auto budget = std::max(size / 2, kMaxSize);
+    std::map<llvm::Function *, std::map<ArgList, llvm::Function *>> clones;
+    std::vector<Specialization> specs;
+    for (const auto &cand : cands) {
+        auto &func_clones = clones[cand.func];
+        if (func_clones.size() >= kMaxClones || cand.cost > budget) continue;
+        budget -= cand.cost;
+        auto clone = CloneWithArgs(*cand.func, cand.args);
+        func_clones[cand.args] = clone;
+        specs.push_back({cand.func->getName().str(), clone, cand.args, 0});
+    }
+    if (specs.empty()) return specs;
+    // redirect calls, including the new calls inside clones
+    std::map<const llvm::Function *, std::size_t> spec_ids;
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        spec_ids[specs[i].clone] = i;
+    }
+    for (auto &&i : clones) {
+        std::vector<llvm::CallInst *> calls;
+        GetCalls(*i.first, calls);
+        for (const auto &call : calls) {
+            if (call->isMustTailCall()) continue;
+            auto it = i.second.find(GetConstArgs(call));
+            if (it == i.second.end()) continue;
+            Redirect(call, it->second, it->first);
+            ++specs[spec_ids[it->second]].call_count;
+        }
+    }
+    return specs;
+}
@@ -0,0 +1,93 @@
+#include <back/llvm/ssa.h>
+
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/ADT/SmallVector.h>
+
+llvm::Value *SSABuilder::ReadVar(Var var, llvm::BasicBlock *block) {
+    // local value numbering
+    auto it = defs_.find({block, var});
+    if (it != defs_.end() && it->second) return it->second;
+    // global value numbering
+    return ReadVarRecursive(var, block);
+}
+
+void SSABuilder::SealBlock(llvm::BasicBlock *block) {
+    auto it = incomplete_phis_.find(block);
+    if (it != incomplete_phis_.end()) {
+        auto phis = std::move(it->second);
+        incomplete_phis_.erase(it);
+        for (const auto &i : phis) AddPhiOperands(i.first, i.second);
+    }
+    sealed_.insert(block);
+}
+
+llvm::Value *SSABuilder::ReadVarRecursive(Var var,
+        llvm::BasicBlock *block) {
+    llvm::Value *value;
+    if (!sealed_.count(block)) {
+        // incomplete CFG, operands will be added when sealing the block
+        auto phi = CreatePhi(block);
+        incomplete_phis_[block].push_back({var, phi});
+        value = phi;
+    }
+    else if (auto pred = block->getSinglePredecessor()) {
+        // no phi needed
+        value = ReadVar(var, pred);
+    }
+    else if (llvm::pred_empty(block)) {
+        // unreachable block
+        value = llvm::UndefValue::get(type_);
+    }
+    else {
+        // break potential cycles with operandless phi
+        auto phi = CreatePhi(block);
+        WriteVar(var, block, phi);
+        value = AddPhiOperands(var, phi);
+    }
+    WriteVar(var, block, value);
+    return value;
+}
+
+llvm::PHINode *SSABuilder::CreatePhi(llvm::BasicBlock *block) {
+    if (block->empty()) return llvm::PHINode::Create(type_, 2, "", block);
+    return llvm::PHINode::Create(type_, 2, "", &block->front());
+}
+
+llvm::Value *SSABuilder::AddPhiOperands(Var var, llvm::PHINode *phi) {
+    // determine operands from predecessors
+    for (auto pred : llvm::predecessors(phi->getParent())) {
+        phi->addIncoming(ReadVar(var, pred), pred);
+    }
+    return TryRemoveTrivialPhi(phi);
+}
+
+llvm::Value *SSABuilder::TryRemoveTrivialPhi(llvm::PHINode *phi) {
+    llvm::Value *same = nullptr;
+    for (const auto &op : phi->incoming_values()) {
+        // unique value or self reference
+        if (op == same || op == phi) continue;
+        // the phi merges at least two values, not trivial
+        if (same) return phi;
+        same = op;
+    }
+    // the phi is unreachable or in the entry block
+    if (!same) same = llvm::UndefValue::get(type_);
+    // remember all users except the phi itself,
+    // they may be removed during the recursion
+    llvm::SmallVector<llvm::WeakVH, 8> users;
+    for (auto user : phi->users()) {
+        if (user != phi) users.push_back(user);
+    }
+    // reroute all uses of phi to 'same' and remove phi
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+    // try to recursively remove all phi users,
+    // which might have become trivial
+    for (const auto &user : users) {
+        if (auto p = llvm::dyn_cast_or_null<llvm::PHINode>(user)) {
+            TryRemoveTrivialPhi(p);
+        }
+    }
+    return same;
+}
@@ -236,5 +236,7 @@ void IdAST::Dump(std::ostream &os) {
 }
 
 void NumberAST::Dump(std::ostream &os) {
+    if (!in_expr) os << indent;
     os << value_;
+    if (!in_expr) os << std::endl;
 }
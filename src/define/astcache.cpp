@@ -0,0 +1,380 @@
+#include <define/astcache.h>
+
+#include <fstream>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define PL01_USE_MMAP
+#endif
+
+/*
+
+format of AST cache (native byte order, all sections are 8-byte aligned):
+    header          see 'CacheHeader'
+    kinds           u8[node_count]
+    bind_types      u8[node_count]
+    flags           u8[node_count]
+    payloads        u32[node_count]
+    lines           u32[node_count]
+    first_child     u32[node_count]
+    child_count     u32[node_count]
+    bind_depths     u32[node_count]
+    bind_slots      u32[node_count]
+    children        u32[child_count]
+    captures        u32[capture_count * 4]
+    string_offsets  u32[string_count + 1]
+    string_data     char[string_bytes]
+
+record of captures section:
+    node, depth, slot, flags (bits 0-7: symbol type, bit 8: by reference)
+    captured variables of the same node are stored in order
+
+*/
+
+namespace {
+
+const char kCacheMagic[8] = "PL01AST";
+const std::uint32_t kCacheVersion = 4;
+const std::uint32_t kByteOrderMark = 0x01020304;
+const std::uint32_t kKindCount = 17;
+const std::uint32_t kSymbolTypeCount = 7;
+
+struct CacheHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t hash;
+    std::uint32_t root;
+    std::uint32_t node_count;
+    std::uint32_t child_count;
+    std::uint32_t string_count;
+    std::uint32_t string_bytes;
+    std::uint32_t capture_count;
+};
+
+inline std::uint64_t Align(std::uint64_t size) {
+    return (size + 7) & ~static_cast<std::uint64_t>(7);
+}
+
+// offsets of all sections
+struct CacheLayout {
+    CacheLayout(const CacheHeader &header) {
+        std::uint64_t nodes = header.node_count;
+        kinds = Align(sizeof(CacheHeader));
+        bind_types = kinds + Align(nodes);
+        flags = bind_types + Align(nodes);
+        payloads = flags + Align(nodes);
+        lines = payloads + Align(nodes * 4);
+        first_child = lines + Align(nodes * 4);
+        child_count = first_child + Align(nodes * 4);
+        bind_depths = child_count + Align(nodes * 4);
+        bind_slots = bind_depths + Align(nodes * 4);
+        children = bind_slots + Align(nodes * 4);
+        captures = children + Align(header.child_count * 4ull);
+        string_offsets = captures + Align(header.capture_count * 16ull);
+        string_data = string_offsets
+                + Align((header.string_count + 1ull) * 4);
+        size = string_data + Align(header.string_bytes);
+    }
+
+    std::uint64_t kinds, bind_types, flags, payloads, lines;
+    std::uint64_t first_child, child_count, bind_depths, bind_slots;
+    std::uint64_t children, captures;
+    std::uint64_t string_offsets, string_data, size;
+};
+
+void WritePadding(std::ostream &os) {
+    const char zeros[8] = {0};
+    auto pos = static_cast<std::uint64_t>(os.tellp());
+    os.write(zeros, Align(pos) - pos);
+}
+
+template <typename T>
+void WriteSection(std::ostream &os, const std::vector<T> &data) {
+    os.write(reinterpret_cast<const char *>(data.data()),
+            data.size() * sizeof(T));
+    WritePadding(os);
+}
+
+template <typename T>
+void ReadSection(const char *base, std::uint64_t offset, std::size_t count,
+        std::vector<T> &data) {
+    auto begin = reinterpret_cast<const T *>(base + offset);
+    data.assign(begin, begin + count);
+}
+
+// 64-bit FNV-1a
+class Hasher {
+public:
+    Hasher() : hash_(0xcbf29ce484222325ull) {}
+
+    void Add(const void *data, std::size_t size) {
+        auto bytes = static_cast<const unsigned char *>(data);
+        for (std::size_t i = 0; i < size; ++i) {
+            hash_ ^= bytes[i];
+            hash_ *= 0x100000001b3ull;
+        }
+    }
+    void Add(std::uint32_t value) { Add(&value, sizeof(value)); }
+    void Add(const std::string &str) {
+        Add(str.size());
+        Add(str.data(), str.size());
+    }
+
+    std::uint64_t hash() const { return hash_; }
+
+private:
+    std::uint64_t hash_;
+};
+
+bool HasStringPayload(FlatAST::Kind kind) {
+    using Kind = FlatAST::Kind;
+    switch (kind) {
+        case Kind::Def: case Kind::Procedure: case Kind::Function:
+        case Kind::Assign: case Kind::FunCall: case Kind::Id:
+        case Kind::Asm: return true;
+        default: return false;
+    }
+}
+
+} // namespace
+
+bool FlatAST::Save(std::ostream &os, std::uint64_t hash) const {
+    // write header
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kCacheMagic, sizeof(kCacheMagic));
+    header.version = kCacheVersion;
+    header.byte_order = kByteOrderMark;
+    header.hash = hash;
+    header.root = root_;
+    header.node_count = kinds_.size();
+    header.child_count = children_.size();
+    header.string_count = strings_.size();
+    std::vector<std::uint32_t> string_offsets = {0};
+    for (const auto &i : strings_) {
+        string_offsets.push_back(string_offsets.back() + i.size());
+    }
+    header.string_bytes = string_offsets.back();
+    // flatten captured variables, sorted by node id
+    std::vector<NodeId> capture_nodes;
+    for (const auto &i : captures_) capture_nodes.push_back(i.first);
+    std::sort(capture_nodes.begin(), capture_nodes.end());
+    std::vector<std::uint32_t> captures;
+    for (const auto &id : capture_nodes) {
+        for (const auto &i : captures_.at(id)) {
+            captures.insert(captures.end(), {id, i.bind.depth, i.bind.slot,
+                    static_cast<std::uint32_t>(i.bind.type)
+                            | (i.by_ref ? 0x100u : 0u)});
+        }
+    }
+    header.capture_count = captures.size() / 4;
+    os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    WritePadding(os);
+    // write node table
+    std::vector<std::uint8_t> bind_types;
+    std::vector<std::uint32_t> bind_depths, bind_slots;
+    for (const auto &i : bindings_) {
+        bind_types.push_back(static_cast<std::uint8_t>(i.type));
+        bind_depths.push_back(i.depth);
+        bind_slots.push_back(i.slot);
+    }
+    WriteSection(os, kinds_);
+    WriteSection(os, bind_types);
+    WriteSection(os, flags_);
+    WriteSection(os, payloads_);
+    WriteSection(os, lines_);
+    WriteSection(os, first_child_);
+    WriteSection(os, child_count_);
+    WriteSection(os, bind_depths);
+    WriteSection(os, bind_slots);
+    WriteSection(os, children_);
+    WriteSection(os, captures);
+    // write string table
+    WriteSection(os, string_offsets);
+    for (const auto &i : strings_) os.write(i.data(), i.size());
+    WritePadding(os);
+    return static_cast<bool>(os);
+}
+
+bool FlatAST::Load(const void *data, std::size_t size, std::uint64_t hash) {
+    auto base = static_cast<const char *>(data);
+    // check header
+    if (size < sizeof(CacheHeader)) return false;
+    CacheHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, kCacheMagic, sizeof(kCacheMagic))
+            || header.version != kCacheVersion
+            || header.byte_order != kByteOrderMark || header.hash != hash) {
+        return false;
+    }
+    CacheLayout layout(header);
+    if (layout.size > size) return false;
+    auto nodes = header.node_count;
+    if (header.root >= nodes) return false;
+    // check node table
+    auto kinds = reinterpret_cast<const std::uint8_t *>(base + layout.kinds);
+    auto bind_types = reinterpret_cast<const std::uint8_t *>(
+            base + layout.bind_types);
+    auto payloads = reinterpret_cast<const std::uint32_t *>(
+            base + layout.payloads);
+    auto first_child = reinterpret_cast<const std::uint32_t *>(
+            base + layout.first_child);
+    auto child_count = reinterpret_cast<const std::uint32_t *>(
+            base + layout.child_count);
+    auto children = reinterpret_cast<const std::uint32_t *>(
+            base + layout.children);
+    for (std::uint32_t i = 0; i < nodes; ++i) {
+        if (kinds[i] >= kKindCount || bind_types[i] >= kSymbolTypeCount) {
+            return false;
+        }
+        if (static_cast<std::uint64_t>(first_child[i]) + child_count[i]
+                > header.child_count) {
+            return false;
+        }
+        if (HasStringPayload(static_cast<Kind>(kinds[i]))
+                && payloads[i] >= header.string_count) {
+            return false;
+        }
+    }
+    for (std::uint32_t i = 0; i < header.child_count; ++i) {
+        if (children[i] >= nodes && children[i] != kNullNode) return false;
+    }
+    auto captures = reinterpret_cast<const std::uint32_t *>(
+            base + layout.captures);
+    for (std::uint32_t i = 0; i < header.capture_count; ++i) {
+        auto record = captures + i * 4;
+        if (record[0] >= nodes || (record[3] & 0xff) >= kSymbolTypeCount
+                || (record[3] >> 8) > 1) {
+            return false;
+        }
+    }
+    // check string table
+    auto string_offsets = reinterpret_cast<const std::uint32_t *>(
+            base + layout.string_offsets);
+    if (string_offsets[0]) return false;
+    for (std::uint32_t i = 0; i < header.string_count; ++i) {
+        if (string_offsets[i] > string_offsets[i + 1]) return false;
+    }
+    if (string_offsets[header.string_count] != header.string_bytes) {
+        return false;
+    }
+    // read all sections
+    Clear();
+    root_ = header.root;
+    ReadSection(base, layout.kinds, nodes, kinds_);
+    ReadSection(base, layout.flags, nodes, flags_);
+    ReadSection(base, layout.payloads, nodes, payloads_);
+    ReadSection(base, layout.lines, nodes, lines_);
+    ReadSection(base, layout.first_child, nodes, first_child_);
+    ReadSection(base, layout.child_count, nodes, child_count_);
+    ReadSection(base, layout.children, header.child_count, children_);
+    auto bind_depths = reinterpret_cast<const std::uint32_t *>(
+            base + layout.bind_depths);
+    auto bind_slots = reinterpret_cast<const std::uint32_t *>(
+            base + layout.bind_slots);
+    for (std::uint32_t i = 0; i < nodes; ++i) {
+        bindings_.push_back({static_cast<SymbolType>(bind_types[i]),
+                bind_depths[i], bind_slots[i]});
+    }
+    for (std::uint32_t i = 0; i < header.capture_count; ++i) {
+        auto record = captures + i * 4;
+        auto type = static_cast<SymbolType>(record[3] & 0xff);
+        captures_[record[0]].push_back({{type, record[1], record[2]},
+                (record[3] >> 8) != 0});
+    }
+    auto string_data = base + layout.string_data;
+    for (std::uint32_t i = 0; i < header.string_count; ++i) {
+        strings_.emplace_back(string_data + string_offsets[i],
+                string_offsets[i + 1] - string_offsets[i]);
+        string_ids_.insert({strings_.back(), i});
+    }
+    return true;
+}
+
+std::uint64_t HashSource(const std::string &source) {
+    Hasher hasher;
+    hasher.Add(source.data(), source.size());
+    return hasher.hash();
+}
+
+std::uint64_t HashSubtree(const FlatAST &ast, FlatAST::NodeId id,
+        std::uint32_t outer_depth) {
+    Hasher hasher;
+    auto add_binding = [&](const Binding &bind) {
+        hasher.Add(static_cast<std::uint32_t>(bind.type));
+        if (bind.depth > outer_depth) {
+            hasher.Add(bind.depth);
+            hasher.Add(bind.slot);
+        }
+    };
+    // pre-order, null children are hashed too
+    std::vector<FlatAST::NodeId> stack = {id};
+    while (!stack.empty()) {
+        auto cur = stack.back();
+        stack.pop_back();
+        if (cur == FlatAST::kNullNode) {
+            hasher.Add(cur);
+            continue;
+        }
+        auto kind = ast.kind(cur);
+        hasher.Add(static_cast<std::uint32_t>(kind));
+        if (HasStringPayload(kind)) {
+            hasher.Add(ast.name(cur));
+        }
+        else {
+            hasher.Add(static_cast<std::uint32_t>(ast.value(cur)));
+        }
+        hasher.Add(ast.is_tail(cur));
+        hasher.Add(ast.is_used(cur));
+        add_binding(ast.binding(cur));
+        for (const auto &i : ast.captures(cur)) {
+            add_binding(i.bind);
+            hasher.Add(i.by_ref);
+        }
+        auto c = ast.children(cur);
+        hasher.Add(c.size());
+        for (auto it = c.end(); it != c.begin();) stack.push_back(*--it);
+    }
+    return hasher.hash();
+}
+
+bool LoadASTCache(const char *file, std::uint64_t hash, FlatAST &ast) {
+#ifdef PL01_USE_MMAP
+    int fd = open(file, O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !st.st_size) {
+        close(fd);
+        return false;
+    }
+    auto data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    auto ret = ast.Load(data, st.st_size, hash);
+    munmap(data, st.st_size);
+    return ret;
+#else
+    std::ifstream ifs(file, std::ios::binary);
+    if (!ifs.is_open()) return false;
+    std::vector<char> data((std::istreambuf_iterator<char>(ifs)),
+            std::istreambuf_iterator<char>());
+    // make sure the data is aligned
+    std::vector<std::uint64_t> buffer(Align(data.size()) / 8);
+    std::memcpy(buffer.data(), data.data(), data.size());
+    return ast.Load(buffer.data(), data.size(), hash);
+#endif
+}
+
+bool SaveASTCache(const char *file, std::uint64_t hash, const FlatAST &ast) {
+    std::ofstream ofs(file, std::ios::binary);
+    if (!ofs.is_open()) return false;
+    return ast.Save(ofs, hash);
+}
@@ -0,0 +1,285 @@
+#include <define/flatast.h>
+
+#include <iomanip>
+
+namespace {
+
+using NodeId = FlatAST::NodeId;
+using Kind = FlatAST::Kind;
+
+// print the same content as 'BaseAST::Dump'
+class Dumper : public FlatASTVisitor<Dumper, void> {
+public:
+    Dumper(const FlatAST &ast, std::ostream &os)
+            : FlatASTVisitor(ast), os_(os), indent_count_(0), in_expr_(0) {}
+
+    void VisitBlock(NodeId id);
+    void VisitConsts(NodeId id);
+    void VisitVars(NodeId id);
+    void VisitDef(NodeId id);
+    void VisitProcedure(NodeId id);
+    void VisitFunction(NodeId id);
+    void VisitAssign(NodeId id);
+    void VisitBeginEnd(NodeId id);
+    void VisitIf(NodeId id);
+    void VisitWhile(NodeId id);
+    void VisitAsm(NodeId id);
+    void VisitControl(NodeId id);
+    void VisitUnary(NodeId id);
+    void VisitBinary(NodeId id);
+    void VisitFunCall(NodeId id);
+    void VisitId(NodeId id);
+    void VisitNumber(NodeId id);
+
+private:
+    std::ostream &Indent() {
+        if (indent_count_) os_ << std::setw(indent_count_ * 2) << ' ';
+        return os_;
+    }
+
+    void DumpChild(const char *title, NodeId id) {
+        if (id == FlatAST::kNullNode) return;
+        ++indent_count_;
+        Indent() << title << std::endl;
+        ++indent_count_;
+        Visit(id);
+        indent_count_ -= 2;
+    }
+
+    std::ostream &os_;
+    int indent_count_, in_expr_;
+};
+
+void Dumper::VisitBlock(NodeId id) {
+    Indent() << "BlockAST {" << std::endl;
+    DumpChild("constants:", ast().child(id, 0));
+    DumpChild("variables:", ast().child(id, 1));
+    auto c = ast().children(id);
+    if (c.size() > 3) {
+        ++indent_count_;
+        Indent() << "procedures/functions:" << std::endl;
+        ++indent_count_;
+        for (auto it = c.begin() + 3; it != c.end(); ++it) Visit(*it);
+        indent_count_ -= 2;
+    }
+    DumpChild("statement:", ast().child(id, 2));
+    Indent() << "}" << std::endl;
+}
+
+void Dumper::VisitConsts(NodeId id) {
+    for (const auto &i : ast().children(id)) Visit(i);
+}
+
+void Dumper::VisitVars(NodeId id) {
+    ++in_expr_;
+    for (const auto &i : ast().children(id)) Visit(i);
+    --in_expr_;
+}
+
+void Dumper::VisitDef(NodeId id) {
+    Indent() << ast().name(id);
+    auto init = ast().child(id, 0);
+    if (init != FlatAST::kNullNode) {
+        os_ << " = ";
+        Visit(init);
+    }
+    os_ << std::endl;
+}
+
+void Dumper::VisitProcedure(NodeId id) {
+    Indent() << "ProcedureAST {" << std::endl;
+    ++indent_count_;
+    Indent() << "id: " << ast().name(id) << std::endl;
+    ++indent_count_;
+    Visit(ast().child(id, 0));
+    indent_count_ -= 2;
+    Indent() << "}" << std::endl;
+}
+
+void Dumper::VisitFunction(NodeId id) {
+    Indent() << "FunctionAST {" << std::endl;
+    ++indent_count_;
+    Indent() << "id: " << ast().name(id) << std::endl;
+    auto c = ast().children(id);
+    if (c.size() > 1) {
+        Indent() << "arguments: ";
+        for (auto it = c.begin() + 1; it != c.end(); ++it) {
+            if (it != c.begin() + 1) os_ << ", ";
+            os_ << ast().name(*it);
+        }
+        os_ << std::endl;
+    }
+    ++indent_count_;
+    Visit(c[0]);
+    indent_count_ -= 2;
+    Indent() << "}" << std::endl;
+}
+
+void Dumper::VisitAssign(NodeId id) {
+    Indent() << ast().name(id) << " <- ";
+    ++in_expr_;
+    Visit(ast().child(id, 0));
+    --in_expr_;
+    os_ << std::endl;
+}
+
+void Dumper::VisitBeginEnd(NodeId id) {
+    Indent() << "BeginEndAST {" << std::endl;
+    ++indent_count_;
+    for (const auto &i : ast().children(id)) Visit(i);
+    --indent_count_;
+    Indent() << "}" << std::endl;
+}
+
+void Dumper::VisitIf(NodeId id) {
+    Indent() << "IfAST {" << std::endl;
+    DumpChild("cond:", ast().child(id, 0));
+    DumpChild("then-body:", ast().child(id, 1));
+    DumpChild("else-body:", ast().child(id, 2));
+    Indent() << "}" << std::endl;
+}
+
+void Dumper::VisitWhile(NodeId id) {
+    Indent() << "WhileAST {" << std::endl;
+    DumpChild("cond:", ast().child(id, 0));
+    DumpChild("body:", ast().child(id, 1));
+    Indent() << "}" << std::endl;
+}
+
+void Dumper::VisitAsm(NodeId id) {
+    Indent() << "AsmAST {" << std::endl;
+    ++indent_count_;
+    Indent();
+    for (const auto &c : ast().name(id)) {
+        os_ << c;
+        if (c == '\n') Indent();
+    }
+    --indent_count_;
+    Indent() << "}" << std::endl;
+}
+
+void Dumper::VisitControl(NodeId id) {
+    Indent();
+    if (ast().keyword(id) == Lexer::Keyword::Break) {
+        os_ << "BreakAST {}";
+    }
+    else {
+        os_ << "ContinueAST {}";
+    }
+    os_ << std::endl;
+}
+
+void Dumper::VisitUnary(NodeId id) {
+    if (!in_expr_) Indent();
+    ++in_expr_;
+    os_ << "Odd(";
+    Visit(ast().child(id, 0));
+    os_ << ")";
+    --in_expr_;
+    if (!in_expr_) os_ << std::endl;
+}
+
+void Dumper::VisitBinary(NodeId id) {
+    using Operator = Lexer::Operator;
+    if (!in_expr_) Indent();
+    ++in_expr_;
+    switch (ast().op(id)) {
+        case Operator::Add: os_ << "Add"; break;
+        case Operator::Sub: os_ << "Sub"; break;
+        case Operator::Mul: os_ << "Mul"; break;
+        case Operator::Div: os_ << "Div"; break;
+        case Operator::Less: os_ << "Lt"; break;
+        case Operator::LessEqual: os_ << "LE"; break;
+        case Operator::Great: os_ << "Gt"; break;
+        case Operator::GreatEqual: os_ << "GE"; break;
+        case Operator::NotEqual: os_ << "NE"; break;
+        case Operator::Equal: os_ << "Eq"; break;
+        default:;
+    }
+    os_ << "(";
+    Visit(ast().child(id, 0));
+    os_ << ", ";
+    Visit(ast().child(id, 1));
+    os_ << ")";
+    --in_expr_;
+    if (!in_expr_) os_ << std::endl;
+}
+
+void Dumper::VisitFunCall(NodeId id) {
+    if (!in_expr_) Indent();
+    ++in_expr_;
+    os_ << ast().name(id) << "(";
+    auto c = ast().children(id);
+    for (auto it = c.begin(); it != c.end(); ++it) {
+        if (it != c.begin()) os_ << ", ";
+        Visit(*it);
+    }
+    os_ << ")";
+    --in_expr_;
+    if (!in_expr_) os_ << std::endl;
+}
+
+void Dumper::VisitId(NodeId id) {
+    if (!in_expr_) Indent();
+    os_ << ast().name(id);
+    if (!in_expr_) os_ << std::endl;
+}
+
+void Dumper::VisitNumber(NodeId id) {
+    if (!in_expr_) Indent();
+    os_ << ast().value(id);
+    if (!in_expr_) os_ << std::endl;
+}
+
+} // namespace
+
+FlatAST::NodeId FlatAST::AddNode(Kind kind, std::uint32_t payload,
+        unsigned int line_pos, std::initializer_list<NodeId> children) {
+    NodeId id = kinds_.size();
+    kinds_.push_back(kind);
+    payloads_.push_back(payload);
+    lines_.push_back(line_pos);
+    first_child_.push_back(children_.size());
+    child_count_.push_back(children.size());
+    bindings_.push_back({SymbolType::Void, 0, 0});
+    flags_.push_back(0);
+    children_.insert(children_.end(), children.begin(), children.end());
+    return id;
+}
+
+FlatAST::NodeId FlatAST::AddNode(Kind kind, std::uint32_t payload,
+        unsigned int line_pos, const std::vector<NodeId> &children) {
+    auto id = AddNode(kind, payload, line_pos, {});
+    child_count_[id] = children.size();
+    children_.insert(children_.end(), children.begin(), children.end());
+    return id;
+}
+
+std::uint32_t FlatAST::AddString(const std::string &str) {
+    auto it = string_ids_.find(str);
+    if (it != string_ids_.end()) return it->second;
+    std::uint32_t index = strings_.size();
+    strings_.push_back(str);
+    string_ids_.insert({str, index});
+    return index;
+}
+
+void FlatAST::Clear() {
+    root_ = kNullNode;
+    kinds_.clear();
+    payloads_.clear();
+    lines_.clear();
+    first_child_.clear();
+    child_count_.clear();
+    bindings_.clear();
+    flags_.clear();
+    captures_.clear();
+    children_.clear();
+    strings_.clear();
+    string_ids_.clear();
+}
+
+void FlatAST::Dump(std::ostream &os) const {
+    if (root_ == kNullNode) return;
+    Dumper(*this, os).Visit(root_);
+}
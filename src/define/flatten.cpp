@@ -0,0 +1,119 @@
+#include <define/ast.h>
+
+namespace {
+
+using NodeId = FlatAST::NodeId;
+using Kind = FlatAST::Kind;
+
+inline NodeId FlattenOpt(const ASTPtr &ast, FlatAST &flat) {
+    return ast ? ast->Flatten(flat) : FlatAST::kNullNode;
+}
+
+NodeId FlattenDefs(Kind kind, const VarDefList &defs,
+        unsigned int line_pos, FlatAST &flat) {
+    std::vector<NodeId> children;
+    for (const auto &i : defs) {
+        auto init = FlattenOpt(i.second, flat);
+        children.push_back(flat.AddNode(Kind::Def, flat.AddString(i.first),
+                line_pos, {init}));
+    }
+    return flat.AddNode(kind, 0, line_pos, children);
+}
+
+} // namespace
+
+NodeId BlockAST::Flatten(FlatAST &flat) {
+    auto consts = FlattenOpt(consts_, flat);
+    auto vars = FlattenOpt(vars_, flat);
+    auto stat = FlattenOpt(stat_, flat);
+    std::vector<NodeId> children = {consts, vars, stat};
+    for (const auto &i : proc_func_) children.push_back(i->Flatten(flat));
+    return flat.AddNode(Kind::Block, 0, line_pos(), children);
+}
+
+NodeId ConstsAST::Flatten(FlatAST &flat) {
+    return FlattenDefs(Kind::Consts, defs_, line_pos(), flat);
+}
+
+NodeId VarsAST::Flatten(FlatAST &flat) {
+    return FlattenDefs(Kind::Vars, defs_, line_pos(), flat);
+}
+
+NodeId ProcedureAST::Flatten(FlatAST &flat) {
+    auto block = block_->Flatten(flat);
+    return flat.AddNode(Kind::Procedure, flat.AddString(id_),
+            line_pos(), {block});
+}
+
+NodeId FunctionAST::Flatten(FlatAST &flat) {
+    std::vector<NodeId> children = {block_->Flatten(flat)};
+    for (const auto &i : args_) {
+        children.push_back(flat.AddNode(Kind::Def, flat.AddString(i),
+                line_pos(), {FlatAST::kNullNode}));
+    }
+    return flat.AddNode(Kind::Function, flat.AddString(id_),
+            line_pos(), children);
+}
+
+NodeId AssignAST::Flatten(FlatAST &flat) {
+    auto expr = expr_->Flatten(flat);
+    return flat.AddNode(Kind::Assign, flat.AddString(id_),
+            line_pos(), {expr});
+}
+
+NodeId BeginEndAST::Flatten(FlatAST &flat) {
+    std::vector<NodeId> children;
+    for (const auto &i : stats_) children.push_back(i->Flatten(flat));
+    return flat.AddNode(Kind::BeginEnd, 0, line_pos(), children);
+}
+
+NodeId IfAST::Flatten(FlatAST &flat) {
+    auto cond = cond_->Flatten(flat);
+    auto then = FlattenOpt(then_, flat);
+    auto else_then = FlattenOpt(else_then_, flat);
+    return flat.AddNode(Kind::If, 0, line_pos(), {cond, then, else_then});
+}
+
+NodeId WhileAST::Flatten(FlatAST &flat) {
+    auto cond = cond_->Flatten(flat);
+    auto body = FlattenOpt(body_, flat);
+    return flat.AddNode(Kind::While, 0, line_pos(), {cond, body});
+}
+
+NodeId AsmAST::Flatten(FlatAST &flat) {
+    return flat.AddNode(Kind::Asm, flat.AddString(asm_str_), line_pos(), {});
+}
+
+NodeId ControlAST::Flatten(FlatAST &flat) {
+    return flat.AddNode(Kind::Control, static_cast<std::uint32_t>(type_),
+            line_pos(), {});
+}
+
+NodeId UnaryAST::Flatten(FlatAST &flat) {
+    auto operand = operand_->Flatten(flat);
+    return flat.AddNode(Kind::Unary, static_cast<std::uint32_t>(op_),
+            line_pos(), {operand});
+}
+
+NodeId BinaryAST::Flatten(FlatAST &flat) {
+    auto lhs = lhs_->Flatten(flat);
+    auto rhs = rhs_->Flatten(flat);
+    return flat.AddNode(Kind::Binary, static_cast<std::uint32_t>(op_),
+            line_pos(), {lhs, rhs});
+}
+
+NodeId FunCallAST::Flatten(FlatAST &flat) {
+    std::vector<NodeId> children;
+    for (const auto &i : args_) children.push_back(i->Flatten(flat));
+    return flat.AddNode(Kind::FunCall, flat.AddString(id_),
+            line_pos(), children);
+}
+
+NodeId IdAST::Flatten(FlatAST &flat) {
+    return flat.AddNode(Kind::Id, flat.AddString(id_), line_pos(), {});
+}
+
+NodeId NumberAST::Flatten(FlatAST &flat) {
+    return flat.AddNode(Kind::Number, static_cast<std::uint32_t>(value_),
+            line_pos(), {});
+}
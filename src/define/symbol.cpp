@@ -1,14 +1,118 @@
 #include <define/symbol.h>
 
-SymbolInfo Environment::GetInfo(const std::string &id, bool recursive) {
-    auto it = symbols_.find(id);
-    if (it != symbols_.end()) {
-        return it->second;
+#include <functional>
+#include <algorithm>
+
+void SymbolTable::PopScope() {
+    assert(!scopes_.empty());
+    // unlink all definitions of current scope
+    auto begin = scopes_.back();
+    while (defs_.size() > begin) {
+        const auto &def = defs_.back();
+        idents_[def.ident].top = def.prev;
+        defs_.pop_back();
     }
-    else if (outer_ && recursive) {
-        return outer_->GetInfo(id);
+    scopes_.pop_back();
+}
+
+void SymbolTable::AddSymbol(const std::string &id, SymbolInfo info) {
+    auto index = InternIdent(id);
+    auto &ident = idents_[index];
+    std::uint32_t def = defs_.size();
+    defs_.push_back({index, ident.top,
+            static_cast<std::uint32_t>(depth()), info});
+    ident.top = def;
+}
+
+void SymbolTable::AddOuterSymbol(const std::string &id, SymbolInfo info) {
+    // outer table is immutable
+    assert(scopes_.size() > 1 && scopes_.back() == defs_.size());
+    AddSymbol(id, info);
+    // move the definition to outer scope
+    --defs_.back().depth;
+    scopes_.back() = defs_.size();
+}
+
+SymbolInfo SymbolTable::GetInfo(const std::string &id) const {
+    auto def = Lookup(id, depth()).second;
+    return def ? def->info : SymbolInfo{SymbolType::Error, 0};
+}
+
+Binding SymbolTable::GetBinding(const std::string &id,
+        std::size_t depth) const {
+    auto ret = Lookup(id, depth);
+    if (!ret.second) return {SymbolType::Error, 0, 0};
+    return ret.first->MakeBinding(ret.second);
+}
+
+bool SymbolTable::IsDefinedInScope(const std::string &id,
+        std::size_t depth) const {
+    auto def = Lookup(id, depth).second;
+    return def && def->depth == depth;
+}
+
+std::uint32_t SymbolTable::FindIdent(const std::string &id,
+        std::size_t hash) const {
+    // linear probing, table is never full
+    auto mask = buckets_.size() - 1;
+    for (auto i = hash & mask;; i = (i + 1) & mask) {
+        auto index = buckets_[i];
+        if (index == kNone) return kNone;
+        const auto &ident = idents_[index];
+        if (ident.hash == hash && ident.name == id) return index;
     }
-    else {
-        return {SymbolType::Error, 0};
+}
+
+std::uint32_t SymbolTable::InternIdent(const std::string &id) {
+    auto hash = std::hash<std::string>()(id);
+    auto index = FindIdent(id, hash);
+    if (index != kNone) return index;
+    // keep load factor below 0.5
+    if ((idents_.size() + 1) * 2 > buckets_.size()) Rehash();
+    index = idents_.size();
+    idents_.push_back({id, hash, kNone});
+    InsertBucket(index);
+    return index;
+}
+
+void SymbolTable::InsertBucket(std::uint32_t index) {
+    auto mask = buckets_.size() - 1;
+    auto i = idents_[index].hash & mask;
+    while (buckets_[i] != kNone) i = (i + 1) & mask;
+    buckets_[i] = index;
+}
+
+void SymbolTable::Rehash() {
+    buckets_.assign(buckets_.size() * 2, kNone);
+    for (std::uint32_t i = 0; i < idents_.size(); ++i) InsertBucket(i);
+}
+
+const SymbolTable::Definition *SymbolTable::GetDefinition(
+        const std::string &id, std::size_t hash, std::size_t depth,
+        std::size_t limit) const {
+    auto index = FindIdent(id, hash);
+    if (index == kNone) return nullptr;
+    // skip definitions of inner scopes and invisible definitions
+    auto def = idents_[index].top;
+    while (def != kNone && (defs_[def].depth > depth || def >= limit)) {
+        def = defs_[def].prev;
     }
+    return def != kNone ? &defs_[def] : nullptr;
+}
+
+std::pair<const SymbolTable *, const SymbolTable::Definition *>
+        SymbolTable::Lookup(const std::string &id, std::size_t depth) const {
+    auto hash = std::hash<std::string>()(id);
+    auto def = GetDefinition(id, hash, depth, defs_.size());
+    if (def || !outer_) return {this, def};
+    return {outer_, outer_->GetDefinition(id, hash,
+            std::min(depth, base_depth_), visible_)};
+}
+
+Binding SymbolTable::MakeBinding(const Definition *def) const {
+    // definitions of a scope are contiguous
+    auto index = static_cast<std::size_t>(def - defs_.data());
+    auto begin = scopes_[def->depth - base_depth_ - 1];
+    return {def->info.type, def->depth,
+            static_cast<std::uint32_t>(index - begin)};
 }
@@ -1,6 +1,8 @@
 #include <front/analyzer.h>
 
 #include <iostream>
+#include <set>
+#include <map>
 
 namespace {
 
@@ -20,68 +22,224 @@ inline bool IsConstOrVar(SymbolType type) {
 
 SymbolType Analyzer::PrintError(const char *message,
         unsigned int line_pos) {
-    std::cerr << "\033[1manalyzer\033[0m (line " << line_pos;
-    std::cerr << "): \033[31m\033[1merror\033[0m: " << message << std::endl;
+    err_ << "\033[1manalyzer\033[0m (line " << line_pos;
+    err_ << "): \033[31m\033[1merror\033[0m: " << message << std::endl;
     ++error_num_;
     return SymbolType::Error;
 }
 
 SymbolType Analyzer::PrintError(const char *message, const char *id,
         unsigned int line_pos) {
-    std::cerr << "\033[1manalyzer\033[0m (line " << line_pos;
-    std::cerr << ", id: " << id << "): \033[31m\033[1merror\033[0m: ";
-    std::cerr << message << std::endl;
+    err_ << "\033[1manalyzer\033[0m (line " << line_pos;
+    err_ << ", id: " << id << "): \033[31m\033[1merror\033[0m: ";
+    err_ << message << std::endl;
     ++error_num_;
     return SymbolType::Error;
 }
 
 SymbolType Analyzer::IsIdDefined(const std::string &id,
         unsigned int line_pos) {
-    if (!IsError(env_->GetInfo(id, false))) {
+    if (symbols_.IsDefinedInScope(id)) {
         return PrintError("identifier has already been defined",
                 id.c_str(), line_pos);
     }
     return SymbolType::Void;
 }
 
-SymbolInfo Analyzer::RecursiveQuery(const std::string &id) {
-    // handle function closure & variable capture
-    SymbolInfo info;
-    if (env_->in_nested_body()) {
-        // env: procedure/function body
-        info = env_->GetInfo(id, false);
-        if (IsError(info)) {
-            // env: function arguments
-            info = env_->outer()->GetInfo(id, false);
-            if (IsError(info)) {
-                // env: outer
-                info = env_->outer()->outer()->GetInfo(id);
-                // add closure symbol to argument env
-                env_->outer()->AddClosureSymbol(id);
+void Analyzer::AddReference(const std::string &id, bool is_write) {
+    auto bind = symbols_.GetBinding(id);
+    auto is_var = bind.type == SymbolType::Var
+            || (bind.type == SymbolType::Ret && is_write);
+    auto is_call = !is_var && (bind.type == SymbolType::Proc
+            || bind.type == SymbolType::Func || bind.type == SymbolType::Ret);
+    // calls of the whole program, including the ones in main program
+    std::size_t use_id;
+    if (is_call && FindUseId(GetBindingKey(bind), use_id)) {
+        calls_.push_back({GetCaller(), use_id});
+    }
+    if (func_stack_.empty()) return;
+    auto &func = funcs_[func_stack_.back()];
+    if (is_var) {
+        // access of variable or return value
+        (is_write ? func.writes : func.reads).push_back(bind);
+        if (bind.depth < func.arg_depth) func.is_pure = false;
+    }
+    else if (is_call) {
+        // call of procedure/function, global ones are not recorded
+        auto it = func_ids_.find(GetBindingKey(bind));
+        if (it != func_ids_.end()) func.callees.push_back(it->second);
+        // only recursive calls and calls of compiled pure functions
+        auto is_self = bind.type == SymbolType::Ret
+                && bind.depth == func.arg_depth;
+        auto is_pure = bind.type == SymbolType::Func
+                && evaluator_.HasFunction(bind);
+        if (!is_self && !is_pure) func.is_pure = false;
+    }
+}
+
+void Analyzer::EnterFunction(const Binding &bind, CaptureList &captures,
+        bool &is_used) {
+    // calls by its binding or its return value, in the whole program,
+    // it may have been declared by 'DeclareFunction'
+    std::size_t use_id;
+    if (!FindUseId(GetBindingKey(bind), use_id)
+            || GetUse(use_id) != &is_used) {
+        use_id = use_base_ + uses_.size();
+        uses_.push_back(&is_used);
+    }
+    use_ids_[GetBindingKey(bind)] = use_id;
+    use_ids_[GetBindingKey({SymbolType::Ret, bind.depth + 1, 0})] = use_id;
+    auto id = funcs_.size();
+    funcs_.push_back({bind.depth + 1, use_id, &captures,
+            bind.type == SymbolType::Func, {}, {}, {}, {}});
+    if (!func_stack_.empty()) funcs_[func_stack_.back()].children.push_back(id);
+    func_stack_.push_back(id);
+    // calls to procedure/function by its binding or its return value
+    func_ids_[GetBindingKey(bind)] = id;
+    func_ids_[GetBindingKey({SymbolType::Ret, bind.depth + 1, 0})] = id;
+    // the previous function with the same binding is no longer visible
+    evaluator_.RemoveFunction(bind);
+}
+
+void Analyzer::DeclareFunction(const Binding &bind, bool &is_used) {
+    use_ids_[GetBindingKey(bind)] = use_base_ + uses_.size();
+    uses_.push_back(&is_used);
+}
+
+void Analyzer::ExitFunction() {
+    func_stack_.pop_back();
+    if (func_stack_.empty()) {
+        ResolveCaptures();
+        funcs_.clear();
+        func_ids_.clear();
+    }
+}
+
+std::size_t Analyzer::GetCaller() const {
+    return func_stack_.empty() ? 0 : funcs_[func_stack_.back()].use_id;
+}
+
+bool Analyzer::FindUseId(std::uint64_t key, std::size_t &use_id) const {
+    auto it = use_ids_.find(key);
+    if (it != use_ids_.end()) {
+        use_id = it->second;
+        return true;
+    }
+    return outer_ && outer_->FindUseId(key, use_id);
+}
+
+bool *Analyzer::GetUse(std::size_t use_id) const {
+    if (use_id < use_base_) return outer_->GetUse(use_id);
+    return uses_[use_id - use_base_];
+}
+
+void Analyzer::MergeUses(const Analyzer &inner) {
+    // indices of 'inner' are moved to the end of current ones
+    auto base = use_base_ + uses_.size();
+    auto remap = [&inner, base](std::size_t use_id) {
+        return use_id < inner.use_base_ ? use_id
+                                        : use_id - inner.use_base_ + base;
+    };
+    uses_.insert(uses_.end(), inner.uses_.begin(), inner.uses_.end());
+    for (const auto &i : inner.calls_) {
+        calls_.push_back({remap(i.first), remap(i.second)});
+    }
+}
+
+void Analyzer::ResolveUses() {
+    std::vector<std::vector<std::size_t>> callees(uses_.size());
+    for (const auto &i : calls_) callees[i.first].push_back(i.second);
+    // depth-first search from the main program
+    std::vector<bool> used(uses_.size(), false);
+    std::vector<std::size_t> stack = {0};
+    used[0] = true;
+    while (!stack.empty()) {
+        auto cur = stack.back();
+        stack.pop_back();
+        for (const auto &i : callees[cur]) {
+            if (!used[i]) {
+                used[i] = true;
+                stack.push_back(i);
             }
         }
     }
-    else {
-        info = env_->GetInfo(id);
+    for (std::size_t i = 1; i < uses_.size(); ++i) *uses_[i] = used[i];
+}
+
+bool Analyzer::IsPureFunction() const {
+    return !func_stack_.empty() && funcs_[func_stack_.back()].is_pure;
+}
+
+void Analyzer::ResolveCaptures() {
+    // variables of the outermost procedure/function and the nested ones
+    // can be captured, global variables can not
+    auto min_depth = funcs_.front().arg_depth;
+    auto is_outer = [min_depth](const FuncNode &func, const Binding &bind) {
+        return bind.depth >= min_depth && bind.depth < func.arg_depth;
+    };
+    // variables modified by nested procedures/functions
+    std::set<std::uint64_t> by_ref;
+    for (const auto &func : funcs_) {
+        for (const auto &i : func.writes) {
+            if (is_outer(func, i)) by_ref.insert(GetBindingKey(i));
+        }
     }
-    return info;
+    // captured variables of a procedure/function also include
+    // the ones captured by its children and callees, until fixed point
+    std::vector<std::map<std::uint64_t, Binding>> caps(funcs_.size());
+    for (auto changed = true; changed;) {
+        changed = false;
+        for (auto i = funcs_.size(); i-- > 0;) {
+            const auto &func = funcs_[i];
+            auto add = [&](const Binding &bind) {
+                if (is_outer(func, bind)
+                        && caps[i].insert({GetBindingKey(bind), bind}).second) {
+                    changed = true;
+                }
+            };
+            for (const auto &b : func.reads) add(b);
+            for (const auto &b : func.writes) add(b);
+            for (auto ids : {&func.children, &func.callees}) {
+                for (const auto &id : *ids) {
+                    if (id == i) continue;
+                    for (const auto &c : caps[id]) add(c.second);
+                }
+            }
+        }
+    }
+    for (std::size_t i = 0; i < funcs_.size(); ++i) {
+        auto &captures = *funcs_[i].captures;
+        captures.clear();
+        for (const auto &c : caps[i]) {
+            captures.push_back({c.second, by_ref.count(c.first) != 0});
+        }
+    }
+}
+
+bool Analyzer::IsTailReturn(const std::string &id) const {
+    if (!is_tail_ || while_count_) return false;
+    // return value is in the arguments scope of current function
+    auto bind = symbols_.GetBinding(id);
+    return bind.type == SymbolType::Ret && bind.depth + 1 == symbols_.depth();
 }
 
 SymbolType Analyzer::AnalyzeConst(const std::string &id, SymbolType init,
-        unsigned int line_pos) {
+        int value, unsigned int line_pos) {
+    // error of initializer has been reported
+    if (IsError(init)) return SymbolType::Error;
     if (init != SymbolType::Const) {
         return PrintError("initialize with non-constant value",
                 id.c_str(), line_pos);
     }
     if (IsError(IsIdDefined(id, line_pos))) return SymbolType::Error;
-    env_->AddSymbol(id, {SymbolType::Const, 0});
+    symbols_.AddSymbol(id, {SymbolType::Const, 0, value});
     return SymbolType::Void;
 }
 
 SymbolType Analyzer::AnalyzeVar(const std::string &id,
         unsigned int line_pos) {
     if (IsError(IsIdDefined(id, line_pos))) return SymbolType::Error;
-    env_->AddSymbol(id, {SymbolType::Var, 0});
+    symbols_.AddSymbol(id, {SymbolType::Var, 0});
     return SymbolType::Void;
 }
 
@@ -97,33 +255,38 @@ SymbolType Analyzer::AnalyzeProcedure(const std::string &id,
         unsigned int line_pos) {
     if (IsError(IsIdDefined(id, line_pos))) return SymbolType::Error;
     // add procedure id to outer environment
-    env_->outer()->AddSymbol(id, {SymbolType::Proc, 0});
+    symbols_.AddOuterSymbol(id, {SymbolType::Proc, 0});
     return SymbolType::Void;
 }
 
 SymbolType Analyzer::AnalyzeFunction(const std::string &id,
         const IdList &args, unsigned int line_pos) {
-    if (!IsError(env_->outer()->GetInfo(id, false))) {
+    if (symbols_.IsDefinedInScope(id, symbols_.depth() - 1)) {
         return PrintError("identifier has already been defined",
                 id.c_str(), line_pos);
     }
+    // add function id to outer environment
+    symbols_.AddOuterSymbol(id, {SymbolType::Func, args.size()});
+    return AnalyzeFunctionArgs(id, args, line_pos);
+}
+
+SymbolType Analyzer::AnalyzeFunctionArgs(const std::string &id,
+        const IdList &args, unsigned int line_pos) {
     // add function id to current environment
     // NOTE: this id is assignable (as return value),
     //       and also callable (recursive call)
-    env_->AddSymbol(id, {SymbolType::Ret, args.size()});
+    symbols_.AddSymbol(id, {SymbolType::Ret, args.size()});
     // add argument id to current environment
     for (const auto &i : args) {
         if (IsError(IsIdDefined(i, line_pos))) return SymbolType::Error;
-        env_->AddSymbol(i, {SymbolType::Var, 0});
+        symbols_.AddSymbol(i, {SymbolType::Var, 0});
     }
-    // add function id to outer environment
-    env_->outer()->AddSymbol(id, {SymbolType::Func, args.size()});
     return SymbolType::Void;
 }
 
 SymbolType Analyzer::AnalyzeAssign(const std::string &id,
         SymbolType expr_type, unsigned int line_pos) {
-    auto info = RecursiveQuery(id);
+    auto info = symbols_.GetInfo(id);
     if (IsError(info)) {
         return PrintError("identifier has not been defined",
                 id.c_str(), line_pos);
@@ -135,6 +298,7 @@ SymbolType Analyzer::AnalyzeAssign(const std::string &id,
     if (!IsConstOrVar(expr_type)) {
         return PrintError("invalid assignment", id.c_str(), line_pos);
     }
+    AddReference(id, true);
     return SymbolType::Void;
 }
 
@@ -143,6 +307,7 @@ SymbolType Analyzer::AnalyzeControl(unsigned int line_pos) {
         return PrintError("try to use break/continue outside 'while' loop",
                 line_pos);
     }
+    is_reachable_ = false;
     return SymbolType::Void;
 }
 
@@ -166,7 +331,7 @@ SymbolType Analyzer::AnalyzeBinary(SymbolType lhs, SymbolType rhs,
 
 SymbolType Analyzer::AnalyzeFunCall(const std::string &id,
         const TypeList &args, unsigned int line_pos) {
-    auto info = RecursiveQuery(id);
+    auto info = symbols_.GetInfo(id);
     if (info.type != SymbolType::Func && info.type != SymbolType::Ret) {
         return PrintError("try to call a non-function",
                 id.c_str(), line_pos);
@@ -179,20 +344,64 @@ SymbolType Analyzer::AnalyzeFunCall(const std::string &id,
             return PrintError("invalid argument", id.c_str(), line_pos);
         }
     }
+    AddReference(id, false);
     return SymbolType::Var;
 }
 
 SymbolType Analyzer::AnalyzeId(const std::string &id,
         unsigned int line_pos) {
-    auto info = RecursiveQuery(id);
+    auto info = symbols_.GetInfo(id);
     if (IsError(info)) {
         return PrintError("identifier has not been defined",
                 id.c_str(), line_pos);
     }
     switch (info.type) {
-        case SymbolType::Proc: return SymbolType::Void;
+        case SymbolType::Proc: {
+            AddReference(id, false);
+            return SymbolType::Void;
+        }
         case SymbolType::Func:
         case SymbolType::Ret: return AnalyzeFunCall(id, {}, line_pos);
-        default: return info.type;
+        default: {
+            AddReference(id, false);
+            return info.type;
+        }
+    }
+}
+
+SymbolType Analyzer::AnalyzeAsm() {
+    // inline assembly may do anything
+    if (!func_stack_.empty()) funcs_[func_stack_.back()].is_pure = false;
+    return SymbolType::Void;
+}
+
+SymbolType Analyzer::EvalUnary(Lexer::Keyword op, int operand, int &value,
+        unsigned int line_pos) {
+    if (op != Lexer::Keyword::Odd) {
+        return PrintError("invalid operator", line_pos);
+    }
+    value = operand & 1;
+    return SymbolType::Const;
+}
+
+SymbolType Analyzer::EvalBinary(Lexer::Operator op, int lhs, int rhs,
+        int &value, unsigned int line_pos) {
+    // division by zero and overflow are left unfolded, they behave like
+    // non-constant divisions at run time, and are harmless in dead code
+    if (!Evaluator::EvalBinary(op, lhs, rhs, value)) return SymbolType::Var;
+    return SymbolType::Const;
+}
+
+SymbolType Analyzer::EvalFunCall(const std::string &id,
+        const std::vector<int> &args, int &value) {
+    auto bind = symbols_.GetBinding(id);
+    if (!evaluator_.Call(bind, args, value)) return SymbolType::Var;
+    // the call has just been recorded, it will be folded into a constant,
+    // so it is no longer a use of the callee
+    std::size_t use_id;
+    if (FindUseId(GetBindingKey(bind), use_id) && !calls_.empty()
+            && calls_.back().second == use_id) {
+        calls_.pop_back();
     }
+    return SymbolType::Const;
 }
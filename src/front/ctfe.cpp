@@ -0,0 +1,333 @@
+#include <front/ctfe.h>
+
+#include <algorithm>
+#include <limits>
+
+IRPtr Evaluator::GenerateBlock(LazyIRGen consts, LazyIRGen vars,
+        LazyIRGen proc_func, LazyIRGen stat) {
+    // function declarations are implemented at run time
+    if (!consts && !vars && !stat) {
+        failed_ = true;
+        return nullptr;
+    }
+    // nested procedures/functions have been compiled separately
+    if (consts) consts();
+    if (vars) vars();
+    if (stat) stat();
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateConst(const std::string &id, const Binding &bind,
+        const IRPtr &expr) {
+    Emit(Op::Store, GetSlot(bind));
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateVar(const std::string &id, const Binding &bind,
+        const IRPtr &init) {
+    if (!init) Emit(Op::Push, 0);
+    Emit(Op::Store, GetSlot(bind));
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateProcedure(const std::string &id,
+        const Binding &bind, const CaptureList &captures,
+        LazyIRGen block) {
+    // procedures are never pure
+    failed_ = true;
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateFunction(const std::string &id,
+        const Binding &bind, const IdList &args,
+        const CaptureList &captures, LazyIRGen block) {
+    RemoveFunction(bind);
+    auto entry = pc();
+    cur_func_ = funcs_.size();
+    funcs_.push_back({entry, static_cast<std::uint32_t>(args.size()),
+            static_cast<std::uint32_t>(args.size() + 1)});
+    arg_depth_ = bind.depth + 1;
+    failed_ = false;
+    block();
+    Emit(Op::Ret);
+    if (failed_) {
+        code_.resize(entry);
+        funcs_.pop_back();
+    }
+    else {
+        func_ids_[GetBindingKey(bind)] = cur_func_;
+    }
+    cur_func_ = kNone;
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateAssign(const Binding &bind, const IRPtr &expr,
+        bool is_tail) {
+    Emit(Op::Store, GetSlot(bind));
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateIf(const IRPtr &cond, LazyIRGen then,
+        LazyIRGen else_then) {
+    auto jump_else = pc();
+    Emit(Op::JumpZero);
+    if (then) then();
+    auto jump_end = pc();
+    Emit(Op::Jump);
+    Patch(jump_else);
+    if (else_then) else_then();
+    Patch(jump_end);
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateWhile(LazyIRGen cond, LazyIRGen body) {
+    loops_.push_back({pc(), {}});
+    cond();
+    auto jump_end = pc();
+    Emit(Op::JumpZero);
+    if (body) body();
+    Emit(Op::Jump, loops_.back().cond);
+    Patch(jump_end);
+    for (const auto &i : loops_.back().breaks) Patch(i);
+    loops_.pop_back();
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateAsm(const std::string &asm_str) {
+    failed_ = true;
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateControl(Lexer::Keyword type) {
+    if (type == Lexer::Keyword::Break) {
+        loops_.back().breaks.push_back(pc());
+        Emit(Op::Jump);
+    }
+    else {
+        Emit(Op::Jump, loops_.back().cond);
+    }
+    return nullptr;
+}
+
+IRPtr Evaluator::GenerateUnary(const IRPtr &operand) {
+    Emit(Op::Odd);
+    return MakeIR();
+}
+
+IRPtr Evaluator::GenerateBinary(Lexer::Operator op,
+        const IRPtr &lhs, const IRPtr &rhs) {
+    Op bin_op;
+    if (GetBinaryOp(op, bin_op)) {
+        Emit(bin_op);
+    }
+    else {
+        failed_ = true;
+    }
+    return MakeIR();
+}
+
+IRPtr Evaluator::GenerateFunCall(const Binding &bind,
+        const IRPtrList &args) {
+    return EmitCall(bind);
+}
+
+IRPtr Evaluator::GenerateId(const Binding &bind) {
+    switch (bind.type) {
+        case SymbolType::Var: Emit(Op::Load, GetSlot(bind)); break;
+        // reading function (or its return value) means calling it
+        case SymbolType::Func: case SymbolType::Ret: return EmitCall(bind);
+        // constants have been folded
+        default: failed_ = true;
+    }
+    return MakeIR();
+}
+
+IRPtr Evaluator::GenerateNumber(int value) {
+    Emit(Op::Push, value);
+    return MakeIR();
+}
+
+void Evaluator::RemoveFunction(const Binding &bind) {
+    func_ids_.erase(GetBindingKey(bind));
+}
+
+bool Evaluator::HasFunction(const Binding &bind) const {
+    return func_ids_.count(GetBindingKey(bind)) != 0;
+}
+
+bool Evaluator::Call(const Binding &bind, const std::vector<int> &args,
+        int &ret) {
+    auto it = func_ids_.find(GetBindingKey(bind));
+    if (it == func_ids_.end()) return false;
+    if (funcs_[it->second].arg_count != args.size()) return false;
+    // indices of compiled functions are never reused,
+    // so results of previous calls are still valid
+    auto key = std::make_pair(it->second, args);
+    auto memo = memo_.find(key);
+    if (memo == memo_.end()) {
+        CallResult result;
+        result.succeeded = Interpret(it->second, args, result.value);
+        memo = memo_.insert({std::move(key), result}).first;
+    }
+    if (memo->second.succeeded) ret = memo->second.value;
+    return memo->second.succeeded;
+}
+
+bool Evaluator::Interpret(std::size_t func, const std::vector<int> &args,
+        int &ret) const {
+    // frames of all calls share the same slot array
+    struct Frame {
+        std::size_t ret_pc, base;
+    };
+    std::vector<Frame> frames;
+    std::vector<int> slots, stack(args);
+    auto enter = [&](std::size_t func, std::size_t ret_pc) {
+        const auto &f = funcs_[func];
+        auto base = slots.size();
+        slots.resize(base + f.frame_size, 0);
+        // arguments are on the top of operand stack
+        auto first = stack.size() - f.arg_count;
+        std::copy(stack.begin() + first, stack.end(),
+                slots.begin() + base + 1);
+        stack.resize(first);
+        frames.push_back({ret_pc, base});
+        return f.entry;
+    };
+    auto pc = enter(func, kNone);
+    for (std::size_t steps = 0; steps < kMaxSteps; ++steps) {
+        const auto &inst = code_[pc++];
+        auto base = frames.back().base;
+        switch (inst.op) {
+            case Op::Push: stack.push_back(inst.operand); break;
+            case Op::Load: stack.push_back(slots[base + inst.operand]); break;
+            case Op::Store: {
+                slots[base + inst.operand] = stack.back();
+                stack.pop_back();
+                break;
+            }
+            case Op::Jump: pc = inst.operand; break;
+            case Op::JumpZero: {
+                if (!stack.back()) pc = inst.operand;
+                stack.pop_back();
+                break;
+            }
+            case Op::Call: {
+                if (frames.size() >= kMaxDepth) return false;
+                pc = enter(inst.operand, pc);
+                break;
+            }
+            case Op::Ret: {
+                auto value = slots[base];
+                auto ret_pc = frames.back().ret_pc;
+                slots.resize(base);
+                frames.pop_back();
+                if (frames.empty()) {
+                    ret = value;
+                    return true;
+                }
+                stack.push_back(value);
+                pc = ret_pc;
+                break;
+            }
+            case Op::Odd: stack.back() &= 1; break;
+            default: {
+                auto rhs = stack.back();
+                stack.pop_back();
+                if (!EvalBinary(inst.op, stack.back(), rhs, stack.back())) {
+                    return false;
+                }
+            }
+        }
+    }
+    // out of budget
+    return false;
+}
+
+std::int32_t Evaluator::GetSlot(const Binding &bind) {
+    auto &func = funcs_[cur_func_];
+    std::uint32_t slot;
+    if (bind.depth == arg_depth_) {
+        slot = bind.slot;
+    }
+    else if (bind.depth == arg_depth_ + 1) {
+        slot = func.arg_count + 1 + bind.slot;
+    }
+    else {
+        // not a local symbol
+        failed_ = true;
+        return 0;
+    }
+    func.frame_size = std::max(func.frame_size, slot + 1);
+    return slot;
+}
+
+IRPtr Evaluator::EmitCall(const Binding &bind) {
+    auto func = kNone;
+    if (bind.type == SymbolType::Ret && bind.depth == arg_depth_) {
+        // recursive call
+        func = cur_func_;
+    }
+    else if (bind.type == SymbolType::Func) {
+        auto it = func_ids_.find(GetBindingKey(bind));
+        if (it != func_ids_.end()) func = it->second;
+    }
+    if (func == kNone) {
+        failed_ = true;
+    }
+    else {
+        Emit(Op::Call, func);
+    }
+    return MakeIR();
+}
+
+bool Evaluator::EvalBinary(Lexer::Operator op, int lhs, int rhs,
+        int &value) {
+    Op bin_op;
+    return GetBinaryOp(op, bin_op) && EvalBinary(bin_op, lhs, rhs, value);
+}
+
+bool Evaluator::GetBinaryOp(Lexer::Operator op, Op &bin_op) {
+    using Operator = Lexer::Operator;
+    switch (op) {
+        case Operator::Add: bin_op = Op::Add; break;
+        case Operator::Sub: bin_op = Op::Sub; break;
+        case Operator::Mul: bin_op = Op::Mul; break;
+        case Operator::Div: bin_op = Op::Div; break;
+        case Operator::Less: bin_op = Op::Less; break;
+        case Operator::LessEqual: bin_op = Op::LessEqual; break;
+        case Operator::Great: bin_op = Op::Great; break;
+        case Operator::GreatEqual: bin_op = Op::GreatEqual; break;
+        case Operator::NotEqual: bin_op = Op::NotEqual; break;
+        case Operator::Equal: bin_op = Op::Equal; break;
+        default: return false;
+    }
+    return true;
+}
+
+bool Evaluator::EvalBinary(Op op, int lhs, int rhs, int &value) {
+    // wrap around on overflow
+    auto l = static_cast<std::uint32_t>(lhs);
+    auto r = static_cast<std::uint32_t>(rhs);
+    switch (op) {
+        case Op::Add: value = static_cast<int>(l + r); break;
+        case Op::Sub: value = static_cast<int>(l - r); break;
+        case Op::Mul: value = static_cast<int>(l * r); break;
+        case Op::Div: {
+            // these trap at run time
+            if (!rhs || (lhs == std::numeric_limits<int>::min()
+                    && rhs == -1)) {
+                return false;
+            }
+            value = lhs / rhs;
+            break;
+        }
+        case Op::Less: value = lhs < rhs; break;
+        case Op::LessEqual: value = lhs <= rhs; break;
+        case Op::Great: value = lhs > rhs; break;
+        case Op::GreatEqual: value = lhs >= rhs; break;
+        case Op::NotEqual: value = lhs != rhs; break;
+        case Op::Equal: value = lhs == rhs; break;
+        default: return false;
+    }
+    return true;
+}
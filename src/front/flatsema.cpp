@@ -0,0 +1,314 @@
+#include <define/flatast.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+namespace {
+
+using NodeId = FlatAST::NodeId;
+
+inline bool IsError(SymbolType type) {
+    return type == SymbolType::Error;
+}
+
+// semantic analysis on flat AST, the same as 'BaseAST::SemaAnalyze'
+class SemaAnalyzer : public FlatASTVisitor<SemaAnalyzer, SymbolType> {
+public:
+    SemaAnalyzer(FlatAST &ast, Analyzer &ana)
+            : FlatASTVisitor(ast), ast_(ast), ana_(ana) {}
+
+    SymbolType VisitBlock(NodeId id);
+    SymbolType VisitConsts(NodeId id);
+    SymbolType VisitVars(NodeId id);
+    SymbolType VisitDef(NodeId id);
+    SymbolType VisitProcedure(NodeId id);
+    SymbolType VisitFunction(NodeId id);
+    SymbolType VisitAssign(NodeId id);
+    SymbolType VisitBeginEnd(NodeId id);
+    SymbolType VisitIf(NodeId id);
+    SymbolType VisitWhile(NodeId id);
+    SymbolType VisitAsm(NodeId id);
+    SymbolType VisitControl(NodeId id);
+    SymbolType VisitUnary(NodeId id);
+    SymbolType VisitBinary(NodeId id);
+    SymbolType VisitFunCall(NodeId id);
+    SymbolType VisitId(NodeId id);
+    SymbolType VisitNumber(NodeId id);
+
+private:
+    // visit an optional child
+    bool IsChildError(NodeId id) {
+        return id != FlatAST::kNullNode && IsError(Visit(id));
+    }
+
+    // record the binding of symbol that defined/referenced by node
+    void SetBinding(NodeId id) {
+        ast_.set_binding(id, ana_.symbols().GetBinding(ast_.name(id)));
+    }
+
+    // fold node into a constant
+    void SetNumber(NodeId id, int value) {
+        ast_.Rewrite(id, Kind::Number, static_cast<std::uint32_t>(value),
+                0, 0);
+    }
+
+    FlatAST &ast_;
+    Analyzer &ana_;
+    // whether procedures/functions are used, see 'Analyzer::ResolveUses'
+    std::unordered_map<NodeId, bool> used_;
+};
+
+SymbolType SemaAnalyzer::VisitBlock(NodeId id) {
+    ana_.NewEnvironment();
+    auto c = ast_.children(id);
+    if (IsChildError(c[0]) || IsChildError(c[1])) return SymbolType::Error;
+    for (auto it = c.begin() + 3; it != c.end(); ++it) {
+        if (IsError(Visit(*it))) return SymbolType::Error;
+    }
+    ana_.set_reachable(true);
+    if (IsChildError(c[2])) return SymbolType::Error;
+    // the whole program has been analyzed
+    if (!ana_.in_function()) {
+        ana_.ResolveUses();
+        for (const auto &i : used_) ast_.set_used(i.first, i.second);
+    }
+    ana_.RestoreEnvironment();
+    return SymbolType::Void;
+}
+
+SymbolType SemaAnalyzer::VisitConsts(NodeId id) {
+    for (const auto &i : ast_.children(id)) {
+        auto init = Visit(i);
+        auto ret = ana_.AnalyzeConst(ast_.name(i), init,
+                ast_.value(ast_.child(i, 0)), ast_.line_pos(id));
+        if (IsError(ret)) return SymbolType::Error;
+        SetBinding(i);
+    }
+    return SymbolType::Void;
+}
+
+SymbolType SemaAnalyzer::VisitVars(NodeId id) {
+    for (const auto &i : ast_.children(id)) {
+        SymbolType ret;
+        if (ast_.child(i, 0) != FlatAST::kNullNode) {
+            ret = ana_.AnalyzeVar(ast_.name(i), Visit(i), ast_.line_pos(id));
+        }
+        else {
+            ret = ana_.AnalyzeVar(ast_.name(i), ast_.line_pos(id));
+        }
+        if (IsError(ret)) return SymbolType::Error;
+        SetBinding(i);
+    }
+    return SymbolType::Void;
+}
+
+SymbolType SemaAnalyzer::VisitDef(NodeId id) {
+    // analyze the initializer only, definition is handled by parent
+    return Visit(ast_.child(id, 0));
+}
+
+SymbolType SemaAnalyzer::VisitProcedure(NodeId id) {
+    ana_.NewEnvironment();
+    if (IsError(ana_.AnalyzeProcedure(ast_.name(id), ast_.line_pos(id)))) {
+        return SymbolType::Error;
+    }
+    ast_.set_binding(id, ana_.GetOuterBinding(ast_.name(id)));
+    ana_.EnterFunction(ast_.binding(id), ast_.captures(id), used_[id]);
+    if (IsError(Visit(ast_.child(id, 0)))) return SymbolType::Error;
+    ana_.ExitFunction();
+    ana_.RestoreEnvironment();
+    return SymbolType::Void;
+}
+
+SymbolType SemaAnalyzer::VisitFunction(NodeId id) {
+    auto c = ast_.children(id);
+    IdList args;
+    for (auto it = c.begin() + 1; it != c.end(); ++it) {
+        args.push_back(ast_.name(*it));
+    }
+    ana_.NewEnvironment();
+    if (IsError(ana_.AnalyzeFunction(ast_.name(id), args,
+                ast_.line_pos(id)))) {
+        return SymbolType::Error;
+    }
+    ast_.set_binding(id, ana_.GetOuterBinding(ast_.name(id)));
+    for (auto it = c.begin() + 1; it != c.end(); ++it) SetBinding(*it);
+    ana_.EnterFunction(ast_.binding(id), ast_.captures(id), used_[id]);
+    auto is_tail = ana_.is_tail();
+    ana_.set_tail(true);
+    if (IsError(Visit(c[0]))) return SymbolType::Error;
+    ana_.set_tail(is_tail);
+    // compile pure function for compile-time evaluation
+    if (ana_.IsPureFunction()) ast_.GenerateIR(ana_.evaluator(), id);
+    ana_.ExitFunction();
+    ana_.RestoreEnvironment();
+    return SymbolType::Void;
+}
+
+SymbolType SemaAnalyzer::VisitAssign(NodeId id) {
+    auto ret = ana_.AnalyzeAssign(ast_.name(id),
+            Visit(ast_.child(id, 0)), ast_.line_pos(id));
+    if (!IsError(ret)) {
+        SetBinding(id);
+        ast_.set_tail(id, ana_.IsTailReturn(ast_.name(id)));
+    }
+    return ret;
+}
+
+SymbolType SemaAnalyzer::VisitBeginEnd(NodeId id) {
+    // only the last statement can be in tail position
+    auto is_tail = ana_.is_tail();
+    // statements after the first unreachable end are dead,
+    // but they are still analyzed to report errors
+    auto c = ast_.children(id);
+    auto live = c.size();
+    std::size_t dead_calls = 0;
+    for (std::size_t i = 0; i < c.size(); ++i) {
+        ana_.set_tail(is_tail && i + 1 == c.size());
+        ana_.set_reachable(true);
+        if (IsError(Visit(c[i]))) return SymbolType::Error;
+        if (i < live && !ana_.is_reachable()) {
+            live = i + 1;
+            dead_calls = ana_.call_count();
+        }
+    }
+    ana_.set_tail(is_tail);
+    if (live < c.size()) {
+        ast_.Rewrite(id, Kind::BeginEnd, 0, 0, live);
+        ana_.RemoveCalls(dead_calls, ana_.call_count());
+        ana_.set_reachable(false);
+    }
+    return SymbolType::Void;
+}
+
+SymbolType SemaAnalyzer::VisitIf(NodeId id) {
+    auto c = ast_.children(id);
+    auto cond = Visit(c[0]);
+    if (IsError(cond)) return SymbolType::Error;
+    ana_.set_reachable(true);
+    auto then_calls = ana_.call_count();
+    if (IsChildError(c[1])) return SymbolType::Error;
+    auto then_reachable = ana_.is_reachable();
+    ana_.set_reachable(true);
+    auto else_calls = ana_.call_count();
+    if (IsChildError(c[2])) return SymbolType::Error;
+    auto else_reachable = ana_.is_reachable();
+    if (cond != SymbolType::Const) {
+        ana_.set_reachable(then_reachable || else_reachable);
+        return SymbolType::Void;
+    }
+    // keep only the live branch if condition is constant
+    std::size_t live = ast_.value(c[0]) ? 1 : 2;
+    ana_.set_reachable(live == 1 ? then_reachable : else_reachable);
+    if (live == 1) {
+        ana_.RemoveCalls(else_calls, ana_.call_count());
+    }
+    else {
+        ana_.RemoveCalls(then_calls, else_calls);
+    }
+    ast_.Rewrite(id, Kind::BeginEnd, 0, live,
+            c[live] != FlatAST::kNullNode ? 1 : 0);
+    return SymbolType::Void;
+}
+
+SymbolType SemaAnalyzer::VisitWhile(NodeId id) {
+    ana_.EnterWhile();
+    auto cond = Visit(ast_.child(id, 0));
+    if (IsError(cond)) return SymbolType::Error;
+    ana_.set_reachable(true);
+    auto body_calls = ana_.call_count();
+    if (IsChildError(ast_.child(id, 1))) return SymbolType::Error;
+    ana_.ExitWhile();
+    // remove the loop if condition is constant false
+    if (cond == SymbolType::Const && !ast_.value(ast_.child(id, 0))) {
+        ast_.Rewrite(id, Kind::BeginEnd, 0, 0, 0);
+        ana_.RemoveCalls(body_calls, ana_.call_count());
+    }
+    ana_.set_reachable(true);
+    return SymbolType::Void;
+}
+
+SymbolType SemaAnalyzer::VisitAsm(NodeId id) {
+    return ana_.AnalyzeAsm();
+}
+
+SymbolType SemaAnalyzer::VisitControl(NodeId id) {
+    return ana_.AnalyzeControl(ast_.line_pos(id));
+}
+
+SymbolType SemaAnalyzer::VisitUnary(NodeId id) {
+    auto operand = ast_.child(id, 0);
+    auto ret = ana_.AnalyzeUnary(Visit(operand), ast_.line_pos(id));
+    if (ret == SymbolType::Const) {
+        int value;
+        ret = ana_.EvalUnary(ast_.keyword(id), ast_.value(operand), value,
+                ast_.line_pos(id));
+        if (!IsError(ret)) SetNumber(id, value);
+    }
+    return ret;
+}
+
+SymbolType SemaAnalyzer::VisitBinary(NodeId id) {
+    auto l = ast_.child(id, 0), r = ast_.child(id, 1);
+    auto lhs = Visit(l);
+    auto rhs = Visit(r);
+    auto ret = ana_.AnalyzeBinary(lhs, rhs, ast_.line_pos(id));
+    if (ret == SymbolType::Const) {
+        int value;
+        ret = ana_.EvalBinary(ast_.op(id), ast_.value(l), ast_.value(r),
+                value, ast_.line_pos(id));
+        if (ret == SymbolType::Const) SetNumber(id, value);
+    }
+    return ret;
+}
+
+SymbolType SemaAnalyzer::VisitFunCall(NodeId id) {
+    TypeList types;
+    for (const auto &i : ast_.children(id)) {
+        auto ret = Visit(i);
+        if (IsError(ret)) return SymbolType::Error;
+        types.push_back(ret);
+    }
+    auto ret = ana_.AnalyzeFunCall(ast_.name(id), types, ast_.line_pos(id));
+    if (IsError(ret)) return ret;
+    SetBinding(id);
+    // try to evaluate the call if all arguments are constants
+    std::vector<int> args;
+    for (const auto &i : ast_.children(id)) {
+        if (ast_.kind(i) != Kind::Number) return ret;
+        args.push_back(ast_.value(i));
+    }
+    int value;
+    ret = ana_.EvalFunCall(ast_.name(id), args, value);
+    if (ret == SymbolType::Const) SetNumber(id, value);
+    return ret;
+}
+
+SymbolType SemaAnalyzer::VisitId(NodeId id) {
+    auto ret = ana_.AnalyzeId(ast_.name(id), ast_.line_pos(id));
+    if (IsError(ret)) return ret;
+    SetBinding(id);
+    if (ret == SymbolType::Const) {
+        SetNumber(id, ana_.symbols().GetInfo(ast_.name(id)).value);
+    }
+    else if (ast_.binding(id).type == SymbolType::Func) {
+        // call of function without arguments
+        int value;
+        ret = ana_.EvalFunCall(ast_.name(id), {}, value);
+        if (ret == SymbolType::Const) SetNumber(id, value);
+    }
+    return ret;
+}
+
+SymbolType SemaAnalyzer::VisitNumber(NodeId id) {
+    return SymbolType::Const;
+}
+
+} // namespace
+
+SymbolType FlatAST::SemaAnalyze(Analyzer &ana) {
+    if (root_ == kNullNode) return SymbolType::Error;
+    return SemaAnalyzer(*this, ana).Visit(root_);
+}
@@ -37,23 +37,22 @@ bool IsOperatorChar(char c) {
 } // namespace
 
 Lexer::Token Lexer::PrintError(const char *message) {
-    std::cerr << "\033[1mlexer\033[0m (line " << line_pos_;
-    std::cerr << "): \033[31m\033[1merror\033[0m: " << message << std::endl;
+    err_ << "\033[1mlexer\033[0m (line " << line_pos_;
+    err_ << "): \033[31m\033[1merror\033[0m: " << message << std::endl;
     ++error_num_;
     return Token::Error;
 }
 
 Lexer::Token Lexer::HandleId() {
-    // read string
-    std::string id;
+    // read string, reuse the buffer of 'id_val_'
+    id_val_.clear();
     do {
-        id += std::tolower(last_char_);
+        id_val_ += std::tolower(last_char_);
         NextChar();
     } while (!IsEOL() && std::isalnum(last_char_));
     // check if string is keyword
-    int index = GetIndex(id.c_str(), keywords);
+    int index = GetIndex(id_val_.c_str(), keywords);
     if (index < 0) {
-        id_val_ = id;
         return Token::Id;
     }
     else {
@@ -70,31 +69,30 @@ Lexer::Token Lexer::HandleNum() {
         NextChar();
     }
     // read number string
-    std::string num;
+    num_buf_.clear();
     do {
-        num += last_char_;
+        num_buf_ += last_char_;
         NextChar();
     } while (!IsEOL() && std::isxdigit(last_char_));
     // convert to integer
     char *end_pos;
-    num_val_ = std::strtol(num.c_str(), &end_pos, hex ? 16 : 10);
+    num_val_ = std::strtol(num_buf_.c_str(), &end_pos, hex ? 16 : 10);
     // check if conversion is valid
-    return *end_pos || (!hex && num[0] == '0' && num.size() > 1) ?
+    return *end_pos || (!hex && num_buf_[0] == '0' && num_buf_.size() > 1) ?
             PrintError("invalid number") : Token::Num;
 }
 
 Lexer::Token Lexer::HandleString() {
-    std::string str;
+    str_val_.clear();
     // start with quotes
     NextChar();
     while (last_char_ != '\'') {
-        str += last_char_;
+        str_val_ += last_char_;
         NextChar();
         if (IsEOL()) return PrintError("expected \"\'\"");
     }
     // eat right quotation mark
     NextChar();
-    str_val_ = str;
     return Token::String;
 }
 
@@ -1,10 +1,35 @@
 #include <front/parser.h>
 
 #include <iostream>
+#include <vector>
+#include <cstddef>
+
+namespace {
+
+using Operator = Lexer::Operator;
+
+inline bool IsAdditive(Operator op) {
+    return op == Operator::Add || op == Operator::Sub;
+}
+
+inline int GetPrecedence(Operator op) {
+    return IsAdditive(op) ? 1 : 2;
+}
+
+// check if operator 'op' can be appended to the chain
+// integer arithmetic wraps around, so additions and subtractions
+// can be regrouped freely, so can multiplications, but not divisions
+inline bool IsChainable(Operator pending, Operator op) {
+    return (IsAdditive(pending) && IsAdditive(op))
+            || (pending == Operator::Mul && op == Operator::Mul);
+}
+
+} // namespace
 
 ASTPtr Parser::PrintError(const char *message) {
-    std::cerr << "\033[1mparser\033[0m (line " << lexer_.line_pos();
-    std::cerr << "): \033[31m\033[1merror\033[0m: " << message << std::endl;
+    auto &err = lexer_.err();
+    err << "\033[1mparser\033[0m (line " << lexer_.line_pos();
+    err << "): \033[31m\033[1merror\033[0m: " << message << std::endl;
     ++error_num_;
     return nullptr;
 }
@@ -38,13 +63,13 @@ ASTPtr Parser::ParseBlock() {
                 break;
             }
             if (error_num_) return nullptr;
-            proc_func.push_back(std::move(pf));
+            if (!recognize_only_) proc_func.push_back(std::move(pf));
         } while (cur_token_ == Token::Keyword);
     }
     // parse statements
     stat = ParseStatement();
     if (error_num_) return nullptr;
-    return std::make_unique<BlockAST>(std::move(consts), std::move(vars),
+    return MakeAST<BlockAST>(std::move(consts), std::move(vars),
             std::move(proc_func), std::move(stat), line_pos);
 }
 
@@ -56,7 +81,8 @@ ASTPtr Parser::ParseConstants() {
         if (NextToken() != Token::Id) {
             return PrintError("identifier required");
         }
-        auto id = lexer_.id_val();
+        std::string id;
+        if (!recognize_only_) id = lexer_.id_val();
         NextToken();
         // eat '='
         if (!IsTokenOperator(Operator::Equal)) {
@@ -67,12 +93,12 @@ ASTPtr Parser::ParseConstants() {
         auto expr = ParseExpression();
         if (error_num_) return nullptr;
         // add to definitions
-        defs.push_back({id, std::move(expr)});
+        if (!recognize_only_) defs.push_back({id, std::move(expr)});
     } while (IsTokenChar(','));
     // check ';'
     if (!IsTokenChar(';')) return PrintError("';' required");
     NextToken();
-    return std::make_unique<ConstsAST>(std::move(defs), line_pos);
+    return MakeAST<ConstsAST>(std::move(defs), line_pos);
 }
 
 ASTPtr Parser::ParseVariables() {
@@ -83,7 +109,8 @@ ASTPtr Parser::ParseVariables() {
         if (NextToken() != Token::Id) {
             return PrintError("identifier required");
         }
-        auto id = lexer_.id_val();
+        std::string id;
+        if (!recognize_only_) id = lexer_.id_val();
         NextToken();
         // check if has initializer
         ASTPtr init;
@@ -93,19 +120,20 @@ ASTPtr Parser::ParseVariables() {
             if (error_num_) return nullptr;
         }
         // add to definitions
-        defs.push_back({id, std::move(init)});
+        if (!recognize_only_) defs.push_back({id, std::move(init)});
     } while (IsTokenChar(','));
     // check ';'
     if (!IsTokenChar(';')) return PrintError("';' required");
     NextToken();
-    return std::make_unique<VarsAST>(std::move(defs), line_pos);
+    return MakeAST<VarsAST>(std::move(defs), line_pos);
 }
 
 ASTPtr Parser::ParseProcedure() {
     auto line_pos = lexer_.line_pos();
     // get identifier
     if (NextToken() != Token::Id) return PrintError("identifier required");
-    auto id = lexer_.id_val();
+    std::string id;
+    if (!recognize_only_) id = lexer_.id_val();
     NextToken();
     // check ';'
     if (!IsTokenChar(';')) return PrintError("';' required");
@@ -116,14 +144,15 @@ ASTPtr Parser::ParseProcedure() {
     // check ';'
     if (!IsTokenChar(';')) return PrintError("';' required");
     NextToken();
-    return std::make_unique<ProcedureAST>(id, std::move(block), line_pos);
+    return MakeAST<ProcedureAST>(id, std::move(block), line_pos);
 }
 
 ASTPtr Parser::ParseFunction() {
     auto line_pos = lexer_.line_pos();
     // get identifier
     if (NextToken() != Token::Id) return PrintError("identifier required");
-    auto id = lexer_.id_val();
+    std::string id;
+    if (!recognize_only_) id = lexer_.id_val();
     NextToken();
     // check if has argument list
     IdList args;
@@ -132,7 +161,7 @@ ASTPtr Parser::ParseFunction() {
             if (NextToken() != Token::Id) {
                 return PrintError("identifier required in argument list");
             }
-            args.push_back(lexer_.id_val());
+            if (!recognize_only_) args.push_back(lexer_.id_val());
             NextToken();
         } while (IsTokenChar(','));
         if (!IsTokenChar(')')) return PrintError("')' required");
@@ -147,7 +176,7 @@ ASTPtr Parser::ParseFunction() {
     // check ';'
     if (!IsTokenChar(';')) return PrintError("';' required");
     NextToken();
-    return std::make_unique<FunctionAST>(id, std::move(args),
+    return MakeAST<FunctionAST>(id, std::move(args),
             std::move(block), line_pos);
 }
 
@@ -172,8 +201,9 @@ ASTPtr Parser::ParseStatement() {
 
 ASTPtr Parser::ParseIdStat() {
     auto line_pos = lexer_.line_pos();
-    // get identifier
-    auto id = lexer_.id_val();
+    // get identifier, not copied in recognizer mode
+    std::string id;
+    if (!recognize_only_) id = lexer_.id_val();
     NextToken();
     // check next token
     if (IsTokenOperator(Operator::Assign)) {
@@ -182,7 +212,7 @@ ASTPtr Parser::ParseIdStat() {
         // get expression
         auto expr = ParseExpression();
         if (error_num_) return nullptr;
-        return std::make_unique<AssignAST>(id, std::move(expr), line_pos);
+        return MakeAST<AssignAST>(id, std::move(expr), line_pos);
     }
     else if (IsTokenChar('(')) {
         // function call
@@ -192,7 +222,7 @@ ASTPtr Parser::ParseIdStat() {
     }
     else {
         // just identifier
-        return std::make_unique<IdAST>(id, line_pos);
+        return MakeAST<IdAST>(id, line_pos);
     }
 }
 
@@ -204,14 +234,14 @@ ASTPtr Parser::ParseFunCall(const std::string &id) {
         NextToken();
         auto expr = ParseExpression();
         if (error_num_) return nullptr;
-        args.push_back(std::move(expr));
+        if (!recognize_only_) args.push_back(std::move(expr));
     } while (IsTokenChar(','));
     // check ')'
     if (!IsTokenChar(')')) {
         return PrintError("')' required in function call");
     }
     NextToken();
-    return std::make_unique<FunCallAST>(id, std::move(args), line_pos);
+    return MakeAST<FunCallAST>(id, std::move(args), line_pos);
 }
 
 ASTPtr Parser::ParseBeginEnd() {
@@ -227,7 +257,7 @@ ASTPtr Parser::ParseBeginEnd() {
     // check 'end'
     if (!IsTokenKeyword(Keyword::End)) return PrintError("'end' required");
     NextToken();
-    return std::make_unique<BeginEndAST>(std::move(stats), line_pos);
+    return MakeAST<BeginEndAST>(std::move(stats), line_pos);
 }
 
 ASTPtr Parser::ParseIf() {
@@ -252,7 +282,7 @@ ASTPtr Parser::ParseIf() {
         else_then = ParseStatement();
         if (error_num_) return nullptr;
     }
-    return std::make_unique<IfAST>(std::move(cond), std::move(then),
+    return MakeAST<IfAST>(std::move(cond), std::move(then),
             std::move(else_then), line_pos);
 }
 
@@ -269,7 +299,7 @@ ASTPtr Parser::ParseWhile() {
     // get body
     auto body = ParseStatement();
     if (error_num_) return nullptr;
-    return std::make_unique<WhileAST>(std::move(cond),
+    return MakeAST<WhileAST>(std::move(cond),
             std::move(body), line_pos);
 }
 
@@ -285,24 +315,24 @@ ASTPtr Parser::ParseAsm() {
     // get assembly
     std::string asm_str;
     while (cur_token_ == Token::String) {
-        asm_str += lexer_.str_val();
+        if (!recognize_only_) asm_str += lexer_.str_val();
         NextToken();
         if (IsTokenChar(';')) {
-            asm_str += '\n';
+            if (!recognize_only_) asm_str += '\n';
             NextToken();
         }
     }
     // check 'end'
     if (!IsTokenKeyword(Keyword::End)) return PrintError("'end' required");
     NextToken();
-    return std::make_unique<AsmAST>(asm_str, line_pos);
+    return MakeAST<AsmAST>(asm_str, line_pos);
 }
 
 ASTPtr Parser::ParseControl() {
     auto line_pos = lexer_.line_pos();
     auto type = lexer_.key_val();
     NextToken();
-    return std::make_unique<ControlAST>(type, line_pos);
+    return MakeAST<ControlAST>(type, line_pos);
 }
 
 ASTPtr Parser::ParseCondition() {
@@ -312,7 +342,7 @@ ASTPtr Parser::ParseCondition() {
         NextToken();
         auto expr = ParseExpression();
         if (error_num_) return nullptr;
-        return std::make_unique<UnaryAST>(Keyword::Odd,
+        return MakeAST<UnaryAST>(Keyword::Odd,
                 std::move(expr), line_pos);
     }
     else {
@@ -326,95 +356,181 @@ ASTPtr Parser::ParseCondition() {
         NextToken();
         auto rhs = ParseExpression();
         if (error_num_) return nullptr;
-        return std::make_unique<BinaryAST>(op,
+        return MakeAST<BinaryAST>(op,
                 std::move(lhs), std::move(rhs), line_pos);
     }
 }
 
-ASTPtr Parser::ParseExpression() {
-    auto line_pos = lexer_.line_pos();
-    // check if has '+' or '-'
-    Operator op;
-    bool has_head_op;
-    if ((has_head_op = IsAddSub())) {
-        op = lexer_.op_val();
-        NextToken();
-    }
-    // get term
-    auto term = ParseTerm();
-    if (error_num_) return nullptr;
-    if (has_head_op) {
-        auto zero = std::make_unique<NumberAST>(0, line_pos);
-        term = std::make_unique<BinaryAST>(op,
-                std::move(zero), std::move(term), line_pos);
+// build a balanced tree of operands in range [begin, end)
+// operators of additive chain are flipped if 'flip' is true
+// operands are still evaluated from left to right
+ASTPtr Parser::BuildChain(OperandList &chain, std::size_t begin,
+        std::size_t end, bool flip) {
+    if (end - begin == 1) return std::move(chain[begin].operand);
+    auto mid = begin + (end - begin) / 2;
+    auto op = chain[mid].op;
+    auto rhs_flip = flip;
+    if (IsAdditive(op)) {
+        // 'a - b + c' -> 'a - (b - c)'
+        bool is_sub = (op == Operator::Sub) != flip;
+        op = is_sub ? Operator::Sub : Operator::Add;
+        rhs_flip = is_sub ? !flip : flip;
     }
-    // get rest terms
-    while (IsAddSub()) {
-        op = lexer_.op_val();
-        NextToken();
-        auto rhs = ParseTerm();
-        if (error_num_) return nullptr;
-        term = std::make_unique<BinaryAST>(op,
-                std::move(term), std::move(rhs), line_pos);
+    auto lhs = BuildChain(chain, begin, mid, flip);
+    auto rhs = BuildChain(chain, mid, end, rhs_flip);
+    return std::make_unique<BinaryAST>(op, std::move(lhs), std::move(rhs),
+            chain[mid].line_pos);
+}
+
+// reduce the chain on the top of stack, the last operand is 'cur'
+void Parser::ReduceChain(ASTPtr &cur) {
+    auto &top = frames_.back();
+    top.chain.push_back({top.pending, std::move(cur), top.line_pos});
+    cur = BuildChain(top.chain, 0, top.chain.size(), false);
+    frames_.pop_back();
+}
+
+// reduce all chains in current parentheses or function call
+void Parser::ReduceChains(ASTPtr &cur) {
+    while (!frames_.empty() && frames_.back().type == FrameType::Chain) {
+        ReduceChain(cur);
     }
-    return term;
 }
 
-ASTPtr Parser::ParseTerm() {
-    auto line_pos = lexer_.line_pos();
-    // get factor
-    auto factor = ParseFactor();
-    if (error_num_) return nullptr;
-    // get rest factors
-    while (IsMulDiv()) {
-        auto op = lexer_.op_val();
-        NextToken();
-        auto rhs = ParseFactor();
-        if (error_num_) return nullptr;
-        factor = std::make_unique<BinaryAST>(op,
-                std::move(factor), std::move(rhs), line_pos);
+// handle binary operator 'op', the lhs of it is 'cur'
+void Parser::PushOperator(ASTPtr &cur, Operator op, unsigned int line_pos) {
+    auto prec = GetPrecedence(op);
+    // reduce chains with higher (or equal but not chainable) precedence
+    while (!frames_.empty() && frames_.back().type == FrameType::Chain) {
+        auto pending = frames_.back().pending;
+        auto top_prec = GetPrecedence(pending);
+        if (top_prec < prec || (top_prec == prec
+                && IsChainable(pending, op))) {
+            break;
+        }
+        ReduceChain(cur);
+    }
+    // append to current chain, or create a new one
+    if (!frames_.empty() && frames_.back().type == FrameType::Chain
+            && IsChainable(frames_.back().pending, op)) {
+        auto &top = frames_.back();
+        top.chain.push_back({top.pending, std::move(cur), top.line_pos});
+        top.pending = op;
+        top.line_pos = line_pos;
+    }
+    else {
+        frames_.push_back({FrameType::Chain, line_pos, {}, op, {}, {}});
+        frames_.back().chain.push_back({Operator::Add, std::move(cur),
+                line_pos});
     }
-    return factor;
 }
 
-ASTPtr Parser::ParseFactor() {
-    auto line_pos = lexer_.line_pos();
-    switch (cur_token_) {
-        case Token::Id: {
-            auto id = lexer_.id_val();
+ASTPtr Parser::ParseExpression() {
+    // iterative operator-precedence parser,
+    // parentheses and function calls are handled by an explicit stack
+    // in recognizer mode, no operator chain will be pushed to the stack
+    // the stack is reused, it may be left dirty by a previous error
+    auto &frames = frames_;
+    frames.clear();
+    ASTPtr cur;
+    bool expr_begin = true;
+    for (;;) {
+        auto line_pos = lexer_.line_pos();
+        // get operand
+        if (expr_begin && IsAddSub()) {
+            // leading '+' or '-', treat as '0 +/- term'
+            cur = MakeAST<NumberAST>(0, line_pos);
+        }
+        else if (cur_token_ == Token::Id) {
+            // identifier is not copied in recognizer mode
+            std::string id;
+            if (!recognize_only_) id = lexer_.id_val();
             NextToken();
             if (IsTokenChar('(')) {
                 // function call
-                auto funcall = ParseFunCall(id);
-                if (error_num_) return nullptr;
-                return funcall;
-            }
-            else {
-                // just identifier
-                return std::make_unique<IdAST>(id, line_pos);
+                frames.push_back({FrameType::Call, line_pos, {}, {},
+                        std::move(id), {}});
+                NextToken();
+                // the first argument may have a leading sign
+                expr_begin = true;
+                continue;
             }
+            // just identifier
+            cur = MakeAST<IdAST>(id, line_pos);
         }
-        case Token::Num: {
-            auto value = lexer_.num_val();
+        else if (cur_token_ == Token::Num) {
+            cur = MakeAST<NumberAST>(lexer_.num_val(), line_pos);
             NextToken();
-            return std::make_unique<NumberAST>(value, line_pos);
         }
-        default: {
-            if (IsTokenChar('(')) {
+        else if (IsTokenChar('(')) {
+            frames.push_back({FrameType::Paren, line_pos, {}, {}, {}, {}});
+            NextToken();
+            expr_begin = true;
+            continue;
+        }
+        else {
+            return PrintError("invalid factor");
+        }
+        expr_begin = false;
+        // get operator, or close parentheses and function calls
+        for (;;) {
+            if (IsAddSub() || IsMulDiv()) {
+                if (!recognize_only_) {
+                    PushOperator(cur, lexer_.op_val(), lexer_.line_pos());
+                }
                 NextToken();
-                auto expr = ParseExpression();
-                if (error_num_) return nullptr;
+                break;
+            }
+            ReduceChains(cur);
+            if (frames.empty()) return cur;
+            auto &top = frames.back();
+            if (top.type == FrameType::Paren) {
                 if (!IsTokenChar(')')) return PrintError("')' required");
+                frames.pop_back();
                 NextToken();
-                return expr;
             }
             else {
-                return PrintError("invalid factor");
+                if (!recognize_only_) top.args.push_back(std::move(cur));
+                if (IsTokenChar(',')) {
+                    NextToken();
+                    expr_begin = true;
+                    break;
+                }
+                if (!IsTokenChar(')')) {
+                    return PrintError("')' required in function call");
+                }
+                cur = MakeAST<FunCallAST>(top.id,
+                        std::move(top.args), top.line_pos);
+                frames.pop_back();
+                NextToken();
             }
         }
     }
 }
 
+ASTPtr Parser::ParseGlobalConsts() {
+    return IsTokenKeyword(Keyword::Const) ? ParseConstants() : nullptr;
+}
+
+ASTPtr Parser::ParseGlobalVars() {
+    return IsTokenKeyword(Keyword::Var) ? ParseVariables() : nullptr;
+}
+
+ASTPtr Parser::ParseGlobalProcFunc() {
+    if (IsTokenKeyword(Keyword::Procedure)) return ParseProcedure();
+    if (IsTokenKeyword(Keyword::Function)) return ParseFunction();
+    return nullptr;
+}
+
+ASTPtr Parser::ParseMainStatement() {
+    auto stat = ParseStatement();
+    if (error_num_) return nullptr;
+    if (!IsTokenChar('.') || NextToken() != Token::End) {
+        return PrintError("source program must end with '.'");
+    }
+    return stat;
+}
+
 ASTPtr Parser::ParseProgram() {
     auto block = ParseBlock();
     if (error_num_) return nullptr;
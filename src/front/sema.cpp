@@ -1,5 +1,8 @@
 #include <define/ast.h>
 
+#include <vector>
+#include <cstddef>
+
 namespace {
 
 inline bool IsError(SymbolType type) {
@@ -19,21 +22,24 @@ SymbolType BlockAST::SemaAnalyze(Analyzer &ana) {
     for (const auto &i : proc_func_) {
         if (IsError(i->SemaAnalyze(ana))) return SymbolType::Error;
     }
+    ana.set_reachable(true);
     if (stat_ && IsError(stat_->SemaAnalyze(ana))) {
         return SymbolType::Error;
     }
+    // the whole program has been analyzed
+    if (!ana.in_function()) ana.ResolveUses();
     ana.RestoreEnvironment();
-    set_env(ana.env());
     return SymbolType::Void;
 }
 
 SymbolType ConstsAST::SemaAnalyze(Analyzer &ana) {
     for (const auto &i : defs_) {
-        auto ret = ana.AnalyzeConst(i.first,
-                i.second->SemaAnalyze(ana), line_pos());
+        auto init = i.second->SemaAnalyze(ana);
+        auto ret = ana.AnalyzeConst(i.first, init, i.second->const_value(),
+                line_pos());
         if (IsError(ret)) return SymbolType::Error;
     }
-    set_env(ana.env());
+    bind_ = ana.symbols().GetBinding(defs_.front().first);
     return SymbolType::Void;
 }
 
@@ -49,7 +55,7 @@ SymbolType VarsAST::SemaAnalyze(Analyzer &ana) {
         }
         if (IsError(ret)) return SymbolType::Error;
     }
-    set_env(ana.env());
+    bind_ = ana.symbols().GetBinding(defs_.front().first);
     return SymbolType::Void;
 }
 
@@ -57,80 +63,192 @@ SymbolType ProcedureAST::SemaAnalyze(Analyzer &ana) {
     // create an empty environment
     // in order to consistent with the environment structure of function
     ana.NewEnvironment();
-    if (IsError(ana.AnalyzeProcedure(id_, line_pos()))
-            || IsError(block_->SemaAnalyze(ana))) {
+    if (IsError(ana.AnalyzeProcedure(id_, line_pos()))) {
         return SymbolType::Error;
     }
+    bind_ = ana.GetOuterBinding(id_);
+    ana.EnterFunction(bind_, captures_, is_used_);
+    if (IsError(block_->SemaAnalyze(ana))) return SymbolType::Error;
+    ana.ExitFunction();
+    ana.RestoreEnvironment();
+    return SymbolType::Void;
+}
+
+SymbolType ProcedureAST::SemaDeclare(Analyzer &ana) {
+    ana.NewEnvironment();
+    if (IsError(ana.AnalyzeProcedure(id_, line_pos()))) {
+        return SymbolType::Error;
+    }
+    bind_ = ana.GetOuterBinding(id_);
+    ana.RestoreEnvironment();
+    ana.DeclareFunction(bind_, is_used_);
+    return SymbolType::Void;
+}
+
+SymbolType ProcedureAST::SemaAnalyzeBody(Analyzer &ana) {
+    ana.NewEnvironment();
+    ana.EnterFunction(bind_, captures_, is_used_);
+    if (IsError(block_->SemaAnalyze(ana))) return SymbolType::Error;
+    ana.ExitFunction();
     ana.RestoreEnvironment();
-    set_env(ana.env());
     return SymbolType::Void;
 }
 
 SymbolType FunctionAST::SemaAnalyze(Analyzer &ana) {
     ana.NewEnvironment();
-    if (IsError(ana.AnalyzeFunction(id_, args_, line_pos()))
-            || IsError(block_->SemaAnalyze(ana))) {
+    if (IsError(ana.AnalyzeFunction(id_, args_, line_pos()))) {
+        return SymbolType::Error;
+    }
+    bind_ = ana.GetOuterBinding(id_);
+    ana.EnterFunction(bind_, captures_, is_used_);
+    auto is_tail = ana.is_tail();
+    ana.set_tail(true);
+    if (IsError(block_->SemaAnalyze(ana))) return SymbolType::Error;
+    ana.set_tail(is_tail);
+    // compile pure function for compile-time evaluation
+    if (ana.IsPureFunction()) GenerateIR(ana.evaluator());
+    ana.ExitFunction();
+    ana.RestoreEnvironment();
+    return SymbolType::Void;
+}
+
+SymbolType FunctionAST::SemaDeclare(Analyzer &ana) {
+    ana.NewEnvironment();
+    if (IsError(ana.AnalyzeFunction(id_, args_, line_pos()))) {
+        return SymbolType::Error;
+    }
+    bind_ = ana.GetOuterBinding(id_);
+    ana.RestoreEnvironment();
+    ana.DeclareFunction(bind_, is_used_);
+    return SymbolType::Void;
+}
+
+SymbolType FunctionAST::SemaAnalyzeBody(Analyzer &ana) {
+    ana.NewEnvironment();
+    if (IsError(ana.AnalyzeFunctionArgs(id_, args_, line_pos()))) {
         return SymbolType::Error;
     }
+    ana.EnterFunction(bind_, captures_, is_used_);
+    auto is_tail = ana.is_tail();
+    ana.set_tail(true);
+    if (IsError(block_->SemaAnalyze(ana))) return SymbolType::Error;
+    ana.set_tail(is_tail);
+    if (ana.IsPureFunction()) GenerateIR(ana.evaluator());
+    ana.ExitFunction();
     ana.RestoreEnvironment();
-    set_env(ana.env());
     return SymbolType::Void;
 }
 
 SymbolType AssignAST::SemaAnalyze(Analyzer &ana) {
     auto ret = ana.AnalyzeAssign(id_, expr_->SemaAnalyze(ana), line_pos());
-    set_env(ana.env());
+    if (!IsError(ret)) {
+        bind_ = ana.symbols().GetBinding(id_);
+        is_tail_ = ana.IsTailReturn(id_);
+    }
     return ret;
 }
 
 SymbolType BeginEndAST::SemaAnalyze(Analyzer &ana) {
-    for (const auto &i : stats_) {
-        if (IsError(i->SemaAnalyze(ana))) return SymbolType::Error;
+    // only the last statement can be in tail position
+    auto is_tail = ana.is_tail();
+    // statements after the first unreachable end are dead,
+    // but they are still analyzed to report errors
+    auto live = stats_.size();
+    std::size_t dead_calls = 0;
+    for (std::size_t i = 0; i < stats_.size(); ++i) {
+        ana.set_tail(is_tail && i + 1 == stats_.size());
+        ana.set_reachable(true);
+        if (IsError(stats_[i]->SemaAnalyze(ana))) return SymbolType::Error;
+        if (i < live && !ana.is_reachable()) {
+            live = i + 1;
+            dead_calls = ana.call_count();
+        }
+    }
+    ana.set_tail(is_tail);
+    if (live < stats_.size()) {
+        stats_.erase(stats_.begin() + live, stats_.end());
+        ana.RemoveCalls(dead_calls, ana.call_count());
+        ana.set_reachable(false);
     }
-    set_env(ana.env());
     return SymbolType::Void;
 }
 
 SymbolType IfAST::SemaAnalyze(Analyzer &ana) {
-    if (IsError(cond_->SemaAnalyze(ana))) return SymbolType::Error;
+    auto cond = cond_->SemaAnalyze(ana);
+    if (IsError(cond)) return SymbolType::Error;
+    ana.set_reachable(true);
+    auto then_calls = ana.call_count();
     if (then_ && IsError(then_->SemaAnalyze(ana))) return SymbolType::Error;
+    auto then_reachable = ana.is_reachable();
+    ana.set_reachable(true);
+    auto else_calls = ana.call_count();
     if (else_then_ && IsError(else_then_->SemaAnalyze(ana))) {
         return SymbolType::Error;
     }
-    set_env(ana.env());
+    auto else_reachable = ana.is_reachable();
+    // remove the dead branch if condition is constant
+    is_pruned_ = cond == SymbolType::Const;
+    if (!is_pruned_) {
+        ana.set_reachable(then_reachable || else_reachable);
+    }
+    else if (cond_->const_value()) {
+        else_then_.reset();
+        ana.RemoveCalls(else_calls, ana.call_count());
+        ana.set_reachable(then_reachable);
+    }
+    else {
+        then_.reset();
+        ana.RemoveCalls(then_calls, else_calls);
+        ana.set_reachable(else_reachable);
+    }
     return SymbolType::Void;
 }
 
 SymbolType WhileAST::SemaAnalyze(Analyzer &ana) {
     ana.EnterWhile();
-    if (IsError(cond_->SemaAnalyze(ana))) return SymbolType::Error;
+    auto cond = cond_->SemaAnalyze(ana);
+    if (IsError(cond)) return SymbolType::Error;
+    ana.set_reachable(true);
+    auto body_calls = ana.call_count();
     if (body_ && IsError(body_->SemaAnalyze(ana))) return SymbolType::Error;
     ana.ExitWhile();
-    set_env(ana.env());
+    // remove the loop body if condition is constant false
+    is_pruned_ = cond == SymbolType::Const && !cond_->const_value();
+    if (is_pruned_) {
+        body_.reset();
+        ana.RemoveCalls(body_calls, ana.call_count());
+    }
+    ana.set_reachable(true);
     return SymbolType::Void;
 }
 
 SymbolType AsmAST::SemaAnalyze(Analyzer &ana) {
-    set_env(ana.env());
-    return SymbolType::Void;
+    return ana.AnalyzeAsm();
 }
 
 SymbolType ControlAST::SemaAnalyze(Analyzer &ana) {
-    auto ret = ana.AnalyzeControl(line_pos());
-    set_env(ana.env());
-    return ret;
+    return ana.AnalyzeControl(line_pos());
 }
 
 SymbolType UnaryAST::SemaAnalyze(Analyzer &ana) {
     auto ret = ana.AnalyzeUnary(operand_->SemaAnalyze(ana), line_pos());
-    set_env(ana.env());
+    if (ret == SymbolType::Const) {
+        ret = ana.EvalUnary(op_, operand_->const_value(), value_,
+                line_pos());
+        is_const_ = !IsError(ret);
+    }
     return ret;
 }
 
 SymbolType BinaryAST::SemaAnalyze(Analyzer &ana) {
-    auto ret = ana.AnalyzeBinary(lhs_->SemaAnalyze(ana),
-            rhs_->SemaAnalyze(ana), line_pos());
-    set_env(ana.env());
+    auto lhs = lhs_->SemaAnalyze(ana);
+    auto rhs = rhs_->SemaAnalyze(ana);
+    auto ret = ana.AnalyzeBinary(lhs, rhs, line_pos());
+    if (ret == SymbolType::Const) {
+        ret = ana.EvalBinary(op_, lhs_->const_value(), rhs_->const_value(),
+                value_, line_pos());
+        is_const_ = ret == SymbolType::Const;
+    }
     return ret;
 }
 
@@ -142,17 +260,34 @@ SymbolType FunCallAST::SemaAnalyze(Analyzer &ana) {
         types.push_back(ret);
     }
     auto ret = ana.AnalyzeFunCall(id_, types, line_pos());
-    set_env(ana.env());
+    if (IsError(ret)) return ret;
+    bind_ = ana.symbols().GetBinding(id_);
+    // try to evaluate the call if all arguments are constants
+    std::vector<int> args;
+    for (std::size_t i = 0; i < args_.size(); ++i) {
+        if (types[i] != SymbolType::Const) return ret;
+        args.push_back(args_[i]->const_value());
+    }
+    ret = ana.EvalFunCall(id_, args, value_);
+    is_const_ = ret == SymbolType::Const;
     return ret;
 }
 
 SymbolType IdAST::SemaAnalyze(Analyzer &ana) {
     auto ret = ana.AnalyzeId(id_, line_pos());
-    set_env(ana.env());
+    if (IsError(ret)) return ret;
+    bind_ = ana.symbols().GetBinding(id_);
+    if (ret == SymbolType::Const) {
+        value_ = ana.symbols().GetInfo(id_).value;
+    }
+    else if (bind_.type == SymbolType::Func) {
+        // call of function without arguments
+        ret = ana.EvalFunCall(id_, {}, value_);
+    }
+    is_const_ = ret == SymbolType::Const;
     return ret;
 }
 
 SymbolType NumberAST::SemaAnalyze(Analyzer &ana) {
-    set_env(ana.env());
     return SymbolType::Const;
 }
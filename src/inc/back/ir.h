@@ -1,29 +1,135 @@
 #ifndef PL01_DEFINE_IR_H_
 #define PL01_DEFINE_IR_H_
 
-#include <memory>
-#include <any>
 #include <vector>
-#include <functional>
+#include <utility>
+#include <type_traits>
+#include <cstddef>
 #include <cassert>
 
-class IRBase {
+/*
+
+IR handle:
+    a trivially copyable (pointer, tag) pair, the pointer is owned by
+    the IR builder (e.g. 'llvm::Value *' of LLVM back end), the tag
+    identifies the pointee type, so that 'IRCast' can check it
+
+IR generator:
+    a non-owning reference to a callable object, the referenced object
+    must outlive the generator, so bind it to a named local object
+    rather than a temporary if the generator is not passed directly
+
+neither of them allocates any memory
+
+*/
+
+class IRPtr {
+public:
+    IRPtr() : ptr_(nullptr), tag_(nullptr) {}
+    IRPtr(std::nullptr_t) : IRPtr() {}
+    template <typename T>
+    explicit IRPtr(T *ptr) : ptr_(ptr), tag_(Tag<T>()) {}
+
+    explicit operator bool() const { return ptr_ != nullptr; }
+
+    template <typename T>
+    T *get() const {
+        assert(!ptr_ || tag_ == Tag<T>());
+        return static_cast<T *>(ptr_);
+    }
+
+private:
+    // address of a static object, unique for each type
+    template <typename T>
+    static const void *Tag() {
+        static const char tag = 0;
+        return &tag;
+    }
+
+    void *ptr_;
+    const void *tag_;
+};
+
+// non-owning view of a list of IR handles
+class IRPtrList {
+public:
+    IRPtrList() : data_(nullptr), size_(0) {}
+    IRPtrList(const IRPtr *data, std::size_t size)
+            : data_(data), size_(size) {}
+    IRPtrList(const std::vector<IRPtr> &list)
+            : data_(list.data()), size_(list.size()) {}
+
+    const IRPtr *begin() const { return data_; }
+    const IRPtr *end() const { return data_ + size_; }
+    std::size_t size() const { return size_; }
+    const IRPtr &operator[](std::size_t i) const { return data_[i]; }
+
+private:
+    const IRPtr *data_;
+    std::size_t size_;
+};
+
+// storage of IR handles, small lists are stored inline
+class IRPtrBuffer {
+public:
+    explicit IRPtrBuffer(std::size_t size) : size_(size) {
+        if (size > kInlineSize) heap_.resize(size);
+    }
+
+    IRPtr &operator[](std::size_t i) { return data()[i]; }
+    operator IRPtrList() const { return IRPtrList(data(), size_); }
+
+private:
+    static constexpr std::size_t kInlineSize = 8;
+
+    IRPtr *data() { return size_ > kInlineSize ? heap_.data() : inline_; }
+    const IRPtr *data() const {
+        return size_ > kInlineSize ? heap_.data() : inline_;
+    }
+
+    std::size_t size_;
+    IRPtr inline_[kInlineSize];
+    std::vector<IRPtr> heap_;
+};
+
+template <typename Fn>
+class FunctionRef;
+
+template <typename Ret, typename... Args>
+class FunctionRef<Ret(Args...)> {
 public:
-    virtual ~IRBase() = default;
+    FunctionRef() : callback_(nullptr), callable_(nullptr) {}
+    FunctionRef(std::nullptr_t) : FunctionRef() {}
+    template <typename F, typename = std::enable_if_t<
+            !std::is_same<std::decay_t<F>, FunctionRef>::value>>
+    FunctionRef(F &&f)
+            : callback_(Call<std::remove_reference_t<F>>),
+              callable_(const_cast<void *>(
+                      static_cast<const void *>(&f))) {}
+
+    Ret operator()(Args... args) const {
+        assert(callback_);
+        return callback_(callable_, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const { return callback_ != nullptr; }
+
+private:
+    template <typename F>
+    static Ret Call(void *callable, Args... args) {
+        return (*static_cast<F *>(callable))(std::forward<Args>(args)...);
+    }
 
-    virtual const std::any value() const = 0;
+    Ret (*callback_)(void *, Args...);
+    void *callable_;
 };
 
-using IRPtr = std::shared_ptr<IRBase>;
-using IRPtrList = std::vector<IRPtr>;
-using LazyIRGen = std::function<IRPtr()>;
+using LazyIRGen = FunctionRef<IRPtr()>;
 
 template <typename T>
-const T IRCast(const IRPtr &ir) {
-    auto ret = ir->value();
-    auto value = std::any_cast<T>(&ret);
-    assert(value != nullptr);
-    return *value;
+T IRCast(const IRPtr &ir) {
+    static_assert(std::is_pointer<T>::value, "T must be a pointer type");
+    return ir.get<std::remove_pointer_t<T>>();
 }
 
 #endif // PL01_DEFINE_IR_H_
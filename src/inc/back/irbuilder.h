@@ -6,6 +6,7 @@
 #include <front/lexer.h>
 #include <back/ir.h>
 #include <define/type.h>
+#include <define/symbol.h>
 
 class IRBuilder {
 public:
@@ -13,15 +14,24 @@ public:
 
     virtual IRPtr GenerateBlock(LazyIRGen consts, LazyIRGen vars,
             LazyIRGen proc_func, LazyIRGen stat) = 0;
-    virtual IRPtr GenerateConst(const std::string &id,
+    // definitions and references of symbols are identified by bindings,
+    // ids are only used for naming
+    virtual IRPtr GenerateConst(const std::string &id, const Binding &bind,
             const IRPtr &expr) = 0;
-    virtual IRPtr GenerateVar(const std::string &id, const IRPtr &init) = 0;
+    virtual IRPtr GenerateVar(const std::string &id, const Binding &bind,
+            const IRPtr &init) = 0;
+    // nested procedures/functions take their captured variables
+    // as extra arguments, see 'CaptureList'
     virtual IRPtr GenerateProcedure(const std::string &id,
+            const Binding &bind, const CaptureList &captures,
             LazyIRGen block) = 0;
     virtual IRPtr GenerateFunction(const std::string &id,
-            const IdList &args, LazyIRGen block) = 0;
-    virtual IRPtr GenerateAssign(const std::string &id,
-            const IRPtr &expr, SymbolType type) = 0;
+            const Binding &bind, const IdList &args,
+            const CaptureList &captures, LazyIRGen block) = 0;
+    // 'is_tail' is true if the assignment is a tail return,
+    // see 'Analyzer::IsTailReturn'
+    virtual IRPtr GenerateAssign(const Binding &bind, const IRPtr &expr,
+            bool is_tail) = 0;
     virtual IRPtr GenerateIf(const IRPtr &cond, LazyIRGen then,
             LazyIRGen else_then) = 0;
     virtual IRPtr GenerateWhile(LazyIRGen cond, LazyIRGen body) = 0;
@@ -30,9 +40,9 @@ public:
     virtual IRPtr GenerateUnary(const IRPtr &operand) = 0;  // 'odd' only
     virtual IRPtr GenerateBinary(Lexer::Operator op,
             const IRPtr &lhs, const IRPtr &rhs) = 0;
-    virtual IRPtr GenerateFunCall(const std::string &id,
+    virtual IRPtr GenerateFunCall(const Binding &bind,
             const IRPtrList &args) = 0;
-    virtual IRPtr GenerateId(const std::string &id, SymbolType type) = 0;
+    virtual IRPtr GenerateId(const Binding &bind) = 0;
     virtual IRPtr GenerateNumber(int value) = 0;
 };
 
@@ -0,0 +1,32 @@
+#ifndef PL01_BACK_LLVM_ATTRS_H_
+#define PL01_BACK_LLVM_ATTRS_H_
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Function.h>
+
+/*
+
+attribute inference:
+    attributes of a procedure/function are inferred from its body and
+    the attributes of its callees, so callees must be inferred first,
+    which is always true since there are no forward references,
+    memory accesses are global variables and captured variables
+    (passed by reference), stack slots of itself are not counted,
+    calls to unknown functions (e.g. inline assembly, procedures and
+    functions defined in other modules) may do anything
+
+external functions:
+    if 'has_runtime' is true, declarations are functions of runtime
+    library (written in C), they may access any memory and may not
+    return, but never unwind or call back into the program
+
+*/
+
+void InferFunctionAttrs(llvm::Function &func, bool has_runtime);
+
+// give internal linkage to all defined global variables and functions
+// except 'main', since they are never used outside the program,
+// and 'fastcc' to those functions
+void InternalizeSymbols(llvm::Module &module);
+
+#endif // PL01_BACK_LLVM_ATTRS_H_
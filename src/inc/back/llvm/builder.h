@@ -3,9 +3,12 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 #include <utility>
 #include <stack>
 #include <map>
+#include <functional>
+#include <cstddef>
 #include <cstdlib>
 
 #include <llvm/IR/IRBuilder.h>
@@ -13,34 +16,41 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/BasicBlock.h>
-#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Instructions.h>
 #include <llvm/IR/Type.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/Support/raw_ostream.h>
 
 #include <back/irbuilder.h>
 #include <back/llvm/value.h>
+#include <back/llvm/ssa.h>
 #include <back/llvm/rawstd.h>
+#include <back/llvm/optimizer.h>
 
 class LLVMIRBuilder : public IRBuilder {
 public:
     LLVMIRBuilder(const std::string &name)
             : builder_(context_),
-              module_(std::make_unique<llvm::Module>(name, context_)) {
-        NewTable();
-        InitializeFPM();
+              module_(std::make_unique<llvm::Module>(name, context_)),
+              has_main_(true), top_index_(0), jobs_(1), opt_budget_(0),
+              size_level_(SizeLevel::None), remarks_(false), pic_(false) {
         InitializeTarget();
     }
 
     IRPtr GenerateBlock(LazyIRGen consts, LazyIRGen vars,
             LazyIRGen proc_func, LazyIRGen stat) override;
-    IRPtr GenerateConst(const std::string &id,
+    IRPtr GenerateConst(const std::string &id, const Binding &bind,
             const IRPtr &expr) override;
-    IRPtr GenerateVar(const std::string &id, const IRPtr &init) override;
-    IRPtr GenerateProcedure(const std::string &id,
+    IRPtr GenerateVar(const std::string &id, const Binding &bind,
+            const IRPtr &init) override;
+    IRPtr GenerateProcedure(const std::string &id, const Binding &bind,
+            const CaptureList &captures, LazyIRGen block) override;
+    IRPtr GenerateFunction(const std::string &id, const Binding &bind,
+            const IdList &args, const CaptureList &captures,
             LazyIRGen block) override;
-    IRPtr GenerateFunction(const std::string &id,
-            const IdList &args, LazyIRGen block) override;
-    IRPtr GenerateAssign(const std::string &id,
-            const IRPtr &expr, SymbolType type) override;
+    IRPtr GenerateAssign(const Binding &bind, const IRPtr &expr,
+            bool is_tail) override;
     IRPtr GenerateIf(const IRPtr &cond, LazyIRGen then,
             LazyIRGen else_then) override;
     IRPtr GenerateWhile(LazyIRGen cond, LazyIRGen body) override;
@@ -49,12 +59,49 @@ public:
     IRPtr GenerateUnary(const IRPtr &operand) override;
     IRPtr GenerateBinary(Lexer::Operator op,
             const IRPtr &lhs, const IRPtr &rhs) override;
-    IRPtr GenerateFunCall(const std::string &id,
+    IRPtr GenerateFunCall(const Binding &bind,
             const IRPtrList &args) override;
-    IRPtr GenerateId(const std::string &id, SymbolType type) override;
+    IRPtr GenerateId(const Binding &bind) override;
     IRPtr GenerateNumber(int value) override;
 
+    // shard mode of parallel compilation, only bodies of the top level
+    // procedures/functions whose index satisfies 'owned' are generated,
+    // others are declared only, skip main function if not 'has_main'
+    void SetShard(bool has_main, std::function<bool(std::size_t)> owned) {
+        has_main_ = has_main;
+        owned_ = std::move(owned);
+    }
+    // move all definitions of module of 'shard' to current module
+    bool LinkModule(const LLVMIRBuilder &shard);
+    // called after all procedures/functions are generated (and all
+    // shards are linked), see 'InternalizeSymbols',
+    // 'SpecializeFunctions' and 'OptimizeModule'
+    void FinishModule();
+
+    // compile module to object, if 'jobs' is greater than 1,
+    // defer optimizations of functions, then optimize and compile the
+    // module in parallel, see 'EmitArchive', the module is consumed
+    bool CompileToObject(llvm::raw_pwrite_stream &os);
     bool CompileToObject(const char *file);
+    void set_jobs(unsigned int jobs) { jobs_ = jobs; }
+    unsigned int jobs() const { return jobs_; }
+    // time budget of optimizing each procedure/function in milliseconds,
+    // zero means unlimited, see 'FunctionOptimizer'
+    void set_opt_budget(unsigned int opt_budget) {
+        opt_budget_ = opt_budget;
+    }
+    unsigned int opt_budget() const { return opt_budget_; }
+    // optimize for size, see 'SetSizeLevel'
+    void set_size_level(SizeLevel size_level) { size_level_ = size_level; }
+    SizeLevel size_level() const { return size_level_; }
+    // report optimizations (e.g. tail calls, specializations,
+    // downgraded pipelines, sizes of functions if optimizing for size)
+    // to stderr
+    void set_remarks(bool remarks) { remarks_ = remarks; }
+    bool remarks() const { return remarks_; }
+    // generate position independent code (e.g. for static-PIE)
+    void set_pic(bool pic) { pic_ = pic; }
+    bool pic() const { return pic_; }
     void Dump(RawStdOStream &&os = std::cerr) {
         module_->print(os, nullptr);
     }
@@ -62,12 +109,58 @@ public:
 private:
     // pair for storing target block of break & continue
     using BreakCont = std::pair<llvm::BasicBlock *, llvm::BasicBlock *>;
+    using Var = SSABuilder::Var;
 
-    void InitializeFPM();
+    IRPtr GenerateMainBlock(LazyIRGen consts, LazyIRGen vars,
+            LazyIRGen proc_func, LazyIRGen stat);
     void InitializeTarget();
-    void OptimizeFunction(llvm::Function *func) { fpm_->run(*func); }
-    llvm::AllocaInst *CreateAlloca(llvm::Function *func);
+    // optimize function now, unless optimizations are deferred to
+    // code generation, see 'CompileToObject'
+    void OptimizeFunction(llvm::Function *func);
+    // check if body of the procedure/function should be generated
+    bool IsBodyOwned();
+    // procedures/functions nested in others are invisible to other modules,
+    // attributes of procedures/functions are inferred before optimizing
+    void FinishFunction(llvm::Function *func, bool is_declare);
+    // enter/exit the body of a function
+    void EnterFunction(llvm::Function *func);
+    void ExitFunction();
+    // create a basic block which has no predecessors in current function
+    llvm::BasicBlock *CreateIsolatedBlock();
+    void SealBlock(llvm::BasicBlock *block) { ssa_.top().SealBlock(block); }
+    // get condition of branch, integers (e.g. folded constants)
+    // are compared with zero
+    llvm::Value *GetCondValue(const IRPtr &cond);
+    // check if the symbol is a local variable of current function,
+    // including variables captured from outer procedures/functions
+    bool IsLocalVar(const Binding &bind) const;
+    // define/read local variable of current function, variables captured
+    // by reference are in stack slots, others are in SSA form
+    void DefineLocal(Var var, llvm::Value *value);
+    llvm::Value *ReadLocal(Var var);
+    void WriteLocal(Var var, llvm::Value *value);
+    // create a procedure/function with captured variables as extra
+    // arguments, variables it captures by reference must be in memory
+    llvm::Function *DeclareFunction(const std::string &id,
+            llvm::Type *ret, std::size_t arg_count,
+            const CaptureList &captures);
+    // bind the extra arguments of current function to captured variables
+    void GenerateCaptures(llvm::Function *func, const CaptureList &captures);
+    // lower the call which returns the return value 'bind' of current
+    // function, self calls become jumps to the start of function body,
+    // other calls become 'musttail' calls if possible
+    bool GenerateTailCall(const Binding &bind, llvm::CallInst *call);
+    bool CanMustTail(llvm::CallInst *call) const;
+    void Remark(const llvm::CallInst *call, const char *message) const;
+    void Remark(const std::string &func, const std::string &message) const;
+    // report sizes of functions before optimizations and 'sizes'
+    void ReportSizes(const FunctionSizes &sizes) const;
+    // name of procedure/function 'id' in module, lifted ones are
+    // named after their parents (e.g. 'parent.id')
     std::string NewFunName(const std::string &id);
+    // pass arguments of main function to runtime library, only if
+    // command line arguments are used by program
+    void PassCommandLineArgs(llvm::Function *main);
 
     template <typename... Args>
     llvm::Function *CreateFunction(const char *name, llvm::Type *ret,
@@ -76,26 +169,44 @@ private:
         auto func_type = llvm::FunctionType::get(ret, args_type, false);
         auto func = llvm::Function::Create(func_type,
                 llvm::Function::ExternalLinkage, name, module_.get());
-        auto body = llvm::BasicBlock::Create(context_, "", func);
-        builder_.SetInsertPoint(body);
+        builder_.SetInsertPoint(llvm::BasicBlock::Create(context_, "", func));
         return func;
     }
 
-    void NewTable() { values_ = std::make_shared<ValueTable>(values_); } 
-    void RestoreTable() { values_ = values_->outer(); }
-
     // LLVM stuffs
     llvm::LLVMContext context_;
     llvm::IRBuilder<> builder_;
     std::unique_ptr<llvm::Module> module_;
-    std::unique_ptr<llvm::legacy::FunctionPassManager> fpm_;
+    // created on first use, after the options are set
+    std::unique_ptr<FunctionOptimizer> opt_;
     // stack for generating break/continue statement
     std::stack<BreakCont> break_cont_;
     // stack for current function
     std::stack<llvm::Function *> cur_func_;
     std::stack<LazyIRGen> gen_func_args_;
-    // constants and variables
-    VTPtr values_;
+    // local variables of current function, in SSA form
+    std::stack<SSABuilder> ssa_;
+    // local variables of current function that captured by reference,
+    // and pointers to all variables that captured by reference
+    std::stack<llvm::DenseSet<Var>> mem_vars_;
+    std::stack<llvm::DenseMap<Var, llvm::Value *>> var_ptrs_;
+    // start of function body, after arguments are defined
+    std::stack<llvm::BasicBlock *> body_entry_;
+    // captured variables of nested procedures/functions
+    llvm::DenseMap<const llvm::Value *, CaptureList> captures_;
+    // constants, variables, procedures and functions
+    ValueTable values_;
+    // shard mode, index of the next top level procedure/function
+    bool has_main_;
+    std::function<bool(std::size_t)> owned_;
+    std::size_t top_index_;
+    // number of threads of optimization and code generation
+    unsigned int jobs_, opt_budget_;
+    SizeLevel size_level_;
+    bool remarks_, pic_;
+    // instruction counts of procedures/functions before optimizations,
+    // in order of generation, only for reporting
+    std::vector<std::pair<std::string, std::size_t>> sizes_;
 };
 
 #endif // PL01_BACK_LLVM_BUILDER_H_
@@ -0,0 +1,68 @@
+#ifndef PL01_BACK_LLVM_CODEGEN_H_
+#define PL01_BACK_LLVM_CODEGEN_H_
+
+#include <memory>
+#include <string>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Object/ArchiveWriter.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <back/llvm/optimizer.h>
+
+// options of optimizations and code generation
+struct CodegenOptions {
+    // number of partitions, see 'EmitArchive'
+    unsigned int jobs;
+    // time budget of each function, see 'FunctionOptimizer'
+    unsigned int opt_budget;
+    SizeLevel size_level;
+    bool remarks;
+    // generate position independent code
+    bool pic;
+};
+
+// whole-program optimizations of 'module', global variables and
+// functions must be internalized before, see 'InternalizeSymbols',
+// functions downgraded by 'RecordPipeline' are skipped, if optimizing
+// for size, identical functions are merged, and repeated code is
+// outlined into new functions for '-Oz'
+void OptimizeModule(llvm::Module &module, SizeLevel size_level);
+// create target machine of host, print error and return nullptr if failed
+// if optimizing for size, every function and global variable is emitted
+// into its own section, so that linker can remove the unused ones
+// (e.g. '--gc-sections' of GNU ld), if 'pic' is set, position
+// independent code is generated, otherwise the default model of target
+std::unique_ptr<llvm::TargetMachine> CreateTargetMachine(
+        SizeLevel size_level, bool pic);
+// emit object file of 'module' to 'os'
+bool EmitObject(llvm::Module &module, llvm::TargetMachine &machine,
+        llvm::raw_pwrite_stream &os);
+
+/*
+
+split code generation:
+    the module is split into 'jobs' partitions, every partition is
+    moved to its own context through bitcode, then its functions are
+    optimized by 'FunctionOptimizer' and it is compiled to an object on its
+    own thread, all objects are written to 'os' as an archive,
+    which can be linked just like a single object, if 'sizes' is not
+    null, instruction counts of optimized functions are added to it
+
+*/
+
+bool EmitArchive(std::unique_ptr<llvm::Module> module,
+        const CodegenOptions &opts, llvm::raw_ostream &os,
+        FunctionSizes *sizes);
+// write objects to 'os' as an archive of target 'triple'
+bool WriteArchive(const llvm::Triple &triple,
+        llvm::ArrayRef<llvm::NewArchiveMember> members,
+        llvm::raw_ostream &os);
+// print remark of optimizations on function 'func' to stderr
+void PrintRemark(const std::string &func, const std::string &message);
+
+#endif // PL01_BACK_LLVM_CODEGEN_H_
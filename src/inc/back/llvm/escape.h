@@ -0,0 +1,37 @@
+#ifndef PL01_BACK_LLVM_ESCAPE_H_
+#define PL01_BACK_LLVM_ESCAPE_H_
+
+#include <cstddef>
+
+#include <llvm/IR/Function.h>
+
+/*
+
+escape analysis:
+    handles of arrays/strings created by 'NewArray'/'NewString' of
+    runtime library are followed through phi nodes and selects, a
+    handle escapes if it is stored to memory (global or captured
+    variables), returned, passed to procedures/functions of program or
+    unknown functions, used in arithmetic, or passed to runtime
+    functions as anything but the array/string they access (e.g. as an
+    element of array), or used in comparisons other than equality with
+    other handles (handles in the arena have different values)
+
+frame arena:
+    handles that never escape are created by 'NewLocalArray' and
+    'NewLocalString' instead, which allocate the array/string together
+    with its initial buffer in a stack-like arena of runtime library,
+    without any 'malloc' or registration in the pool, 'EnterFrame' at
+    the entry of function marks the arena, and 'LeaveFrame' before
+    every return (and before 'musttail' calls) releases everything
+    allocated since then, all runtime functions accept handles of
+    both kinds, freeing the last allocated one releases it at once
+
+*/
+
+// move arrays/strings of 'func' that never escape to the frame arena,
+// return the number of moved allocations, declarations of 'func' must
+// be functions of runtime library
+std::size_t AllocateInFrame(llvm::Function &func);
+
+#endif // PL01_BACK_LLVM_ESCAPE_H_
@@ -0,0 +1,36 @@
+#ifndef PL01_BACK_LLVM_INCREMENTAL_H_
+#define PL01_BACK_LLVM_INCREMENTAL_H_
+
+#include <functional>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include <define/flatast.h>
+#include <back/llvm/builder.h>
+
+/*
+
+incremental compilation:
+    every used top level procedure/function is compiled to its own
+    object, with only the procedures/functions it calls declared,
+    the main function and global variables are compiled to another
+    object, objects are cached in directory 'dir' and named by the
+    structural hash of their subtrees (see 'HashSubtree'), which
+    include names and types of all referenced symbols, so only the
+    changed ones are compiled again, then all objects are written to
+    'os' as an archive, 'jobs' objects are compiled in parallel,
+    options of their builders are set by 'init'
+
+whole-program optimizations:
+    objects must not depend on each other, so symbols are never
+    internalized, and the attributes of callees are unknown when
+    inferring attributes, see 'InferFunctionAttrs'
+
+*/
+
+using BuilderInit = std::function<void(LLVMIRBuilder &)>;
+
+bool CompileIncremental(const FlatAST &ast, const char *dir,
+        llvm::raw_ostream &os, unsigned int jobs, const BuilderInit &init);
+
+#endif // PL01_BACK_LLVM_INCREMENTAL_H_
@@ -1,18 +1,21 @@
 #ifndef PL01_BACK_LLVM_IR_H_
 #define PL01_BACK_LLVM_IR_H_
 
+#include <cassert>
+
 #include <llvm/IR/Value.h>
 
 #include <back/ir.h>
 
-class LLVMIR : public IRBase {
-public:
-    LLVMIR(llvm::Value *value) : value_(value) {}
-
-    const std::any value() const override { return value_; }
+// IR handles of LLVM back end always point to 'llvm::Value'
+inline IRPtr MakeIR(llvm::Value *value) {
+    return IRPtr(value);
+}
 
-private:
-    llvm::Value *value_;
-};
+inline llvm::Value *GetValue(const IRPtr &ir) {
+    auto v = IRCast<llvm::Value *>(ir);
+    assert(v);
+    return v;
+}
 
 #endif // PL01_BACK_LLVM_IR_H_
@@ -0,0 +1,40 @@
+#ifndef PL01_BACK_LLVM_LINKER_H_
+#define PL01_BACK_LLVM_LINKER_H_
+
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+
+#include <back/llvm/optimizer.h>
+
+/*
+
+linking:
+    the object (or archive of objects) in memory is linked with the
+    runtime library 'runtime' into executable 'file' by a single
+    command of the system compiler driver ('cc', or 'PL01_CC' if it
+    is set), the object is passed through an anonymous memory file on
+    Linux, so no temporary files are created, on other systems a
+    temporary file is used, if optimizing for size, unused sections
+    are removed by '--gc-sections'
+
+linking modes:
+    dynamic:    position dependent executable linked with shared C
+                library, the default
+    static:     position dependent static executable, there is no
+                dynamic loader and no relocation at startup, so it
+                starts fastest
+    static-PIE: static position independent executable, which only
+                relocates itself at startup, the object must be
+                compiled as position independent code
+
+*/
+
+enum class LinkMode { Dynamic, Static, StaticPIE };
+
+bool LinkExecutable(llvm::StringRef object, const std::string &runtime,
+        const std::string &file, LinkMode mode, SizeLevel size_level);
+// default path of runtime library, next to the compiler executable
+std::string GetDefaultRuntime(const char *argv0);
+
+#endif // PL01_BACK_LLVM_LINKER_H_
@@ -0,0 +1,104 @@
+#ifndef PL01_BACK_LLVM_OPTIMIZER_H_
+#define PL01_BACK_LLVM_OPTIMIZER_H_
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <map>
+#include <utility>
+#include <cstddef>
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/LegacyPassManager.h>
+
+/*
+
+optimization pipelines:
+    full:       instcombine, reassociate, GVN, loop rotation & LICM,
+                CFG simplification, plus whole-program GVN & LICM in
+                'OptimizeModule'
+    cheap:      early CSE, CFG simplification
+    minimal:    CFG simplification, then the function is marked
+                'optnone', so code generation takes its fast path
+
+compile-time governance:
+    GVN and instcombine are superlinear in the size of a function
+    (e.g. enormous straight-line bodies), and so is instruction
+    selection in the size of basic blocks
+
+    size and complexity of every function are estimated before it is
+    optimized, functions with too many instructions, basic blocks or
+    memory accesses, or with too large basic blocks, are downgraded
+    to the cheaper pipelines and reported as remarks
+
+    the choice is recorded in the attributes of the function, so it
+    is made only once, whole-program passes of 'OptimizeModule' skip
+    the downgraded functions
+
+    with a time budget, the remaining passes of a function are skipped
+    once its budget is exhausted, a running pass is never interrupted,
+    so a single pass may still exceed the budget
+
+*/
+
+enum class Pipeline { Full, Cheap, Minimal };
+
+// choose pipeline of 'func' by its estimated size and complexity,
+// write the reason of downgrade to 'reason' if it is not null
+Pipeline GetPipeline(const llvm::Function &func,
+        std::string *reason = nullptr);
+// choose pipeline of 'func' by 'GetPipeline' and record it, return
+// a description of the downgrade, or an empty string if not downgraded
+std::string RecordPipeline(llvm::Function &func);
+// check if pipeline of 'func' has been recorded
+bool HasRecordedPipeline(const llvm::Function &func);
+// get the recorded pipeline of 'func', 'Full' if not recorded
+Pipeline GetRecordedPipeline(const llvm::Function &func);
+
+class FunctionOptimizer {
+public:
+    // 'budget' is the time budget of each function in milliseconds,
+    // zero means unlimited
+    FunctionOptimizer(llvm::Module *module, unsigned int budget);
+
+    // optimize 'func' by its recorded pipeline (record it first if
+    // not recorded), return a description of the downgrade it
+    // recorded and the stop of budget, or an empty string
+    std::string Run(llvm::Function &func);
+
+private:
+    // stage of pipeline, only one pass (or a group of passes that
+    // depend on each other) in every pass manager
+    using Stage = std::pair<const char *,
+            std::unique_ptr<llvm::legacy::FunctionPassManager>>;
+
+    void AddStage(std::vector<Stage> &stages, const char *name,
+            std::vector<llvm::Pass *> passes);
+
+    llvm::Module *module_;
+    unsigned int budget_;
+    std::vector<Stage> full_, cheap_, minimal_;
+};
+
+/*
+
+size optimizations ('-Os' and '-Oz'):
+    procedures/functions are marked 'optsize' (and 'minsize' for
+    '-Oz'), so that passes (e.g. loop rotation, instcombine) and code
+    generation prefer smaller code, see 'OptimizeModule' and
+    'CreateTargetMachine' for the rest of size optimizations
+
+*/
+
+enum class SizeLevel { None, Small, Smallest };
+
+// instruction counts of procedures/functions by name
+using FunctionSizes = std::map<std::string, std::size_t>;
+
+// mark 'func' to be optimized for size
+void SetSizeLevel(llvm::Function &func, SizeLevel level);
+// add instruction counts of defined functions of 'module' to 'sizes'
+void AddFunctionSizes(const llvm::Module &module, FunctionSizes &sizes);
+
+#endif // PL01_BACK_LLVM_OPTIMIZER_H_
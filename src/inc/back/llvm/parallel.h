@@ -0,0 +1,32 @@
+#ifndef PL01_BACK_LLVM_PARALLEL_H_
+#define PL01_BACK_LLVM_PARALLEL_H_
+
+#include <define/ast.h>
+#include <front/analyzer.h>
+#include <back/llvm/builder.h>
+
+/*
+
+parallel compilation:
+    top level procedures/functions are declared by the main analyzer
+    in order, then their bodies are analyzed by 'jobs' workers, each
+    procedure/function is analyzed by a snapshot of the environment,
+    calls they recorded are merged into the main analyzer before the
+    main statement is analyzed, after reachability is resolved,
+    workers compile procedures/functions to their own module shards,
+    all shards are linked into the module of 'irb'
+
+    a snapshot only evaluates the pure functions nested in its own
+    procedure/function at compile time, calls between top level
+    functions are left to the back end, if the parallel analysis
+    fails (e.g. a constant is initialized by such a call), the whole
+    program is analyzed again in order, which also reports the errors,
+    so the same programs are accepted as serial compilation, returns
+    false if there are any errors
+
+*/
+
+bool CompileParallel(BlockAST &program, LLVMIRBuilder &irb,
+        unsigned int jobs);
+
+#endif // PL01_BACK_LLVM_PARALLEL_H_
@@ -0,0 +1,48 @@
+#ifndef PL01_BACK_LLVM_SPECIALIZE_H_
+#define PL01_BACK_LLVM_SPECIALIZE_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Function.h>
+
+/*
+
+function specialization:
+    call sites which pass constants to some arguments of a procedure
+    or function are grouped by those constants, a group may get its own
+    clone of the callee, in which the constant arguments are removed
+    from the prototype and replaced by their values, so the function
+    pass manager can propagate them through the body, calls inside the
+    clones (e.g. recursive calls which pass the argument through) are
+    redirected to the clones too
+
+cost model:
+    benefit of a group is the number of its call sites multiplied by
+    the number of instructions that use the constant arguments (twice
+    for comparisons, since they decide branches), cost is the size of
+    the callee, or zero if the group covers all calls of the callee
+    (which will then be removed), groups are cloned in order of benefit
+    per cost, a callee gets at most four clones, callees larger than
+    256 instructions are never cloned, and the module may grow by at
+    most half of its size
+
+*/
+
+struct Specialization {
+    std::string callee;
+    llvm::Function *clone;
+    // indices and values of the constant arguments
+    std::vector<std::pair<unsigned int, int>> args;
+    std::size_t call_count;
+};
+
+// specialize procedures/functions of 'module', return all clones,
+// which are not optimized yet, functions must be internalized before,
+// see 'InternalizeSymbols'
+std::vector<Specialization> SpecializeFunctions(llvm::Module &module);
+
+#endif // PL01_BACK_LLVM_SPECIALIZE_H_
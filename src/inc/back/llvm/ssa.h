@@ -0,0 +1,65 @@
+#ifndef PL01_BACK_LLVM_SSA_H_
+#define PL01_BACK_LLVM_SSA_H_
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Type.h>
+#include <llvm/IR/Value.h>
+#include <llvm/IR/ValueHandle.h>
+
+/*
+
+on-the-fly SSA construction (Braun et al. 2013):
+    definitions of variables are recorded per basic block, reading a
+    variable searches its definition in current block and then in the
+    predecessors, phi nodes are placed at the join points on demand
+
+sealed block:
+    a block whose predecessors are all known, reading a variable in an
+    unsealed block creates an incomplete phi node, its operands are
+    filled when sealing the block, trivial phi nodes (all operands are
+    the same value or the phi itself) are removed immediately
+
+all variables of one builder have the same type, and are identified by
+integers given by the user, one builder is used for only one function
+
+*/
+
+class SSABuilder {
+public:
+    using Var = std::uint64_t;
+
+    SSABuilder(llvm::Type *type) : type_(type) {}
+
+    void DeclareVar(Var var) { vars_.insert(var); }
+    bool IsVar(Var var) const { return vars_.count(var); }
+    void WriteVar(Var var, llvm::BasicBlock *block, llvm::Value *value) {
+        defs_[{block, var}] = value;
+    }
+    llvm::Value *ReadVar(Var var, llvm::BasicBlock *block);
+    void SealBlock(llvm::BasicBlock *block);
+
+private:
+    llvm::Value *ReadVarRecursive(Var var, llvm::BasicBlock *block);
+    llvm::PHINode *CreatePhi(llvm::BasicBlock *block);
+    llvm::Value *AddPhiOperands(Var var, llvm::PHINode *phi);
+    llvm::Value *TryRemoveTrivialPhi(llvm::PHINode *phi);
+
+    llvm::Type *type_;
+    llvm::DenseSet<Var> vars_;
+    // current definition of variables in each block,
+    // value handles follow the replacement of trivial phi nodes
+    llvm::DenseMap<std::pair<llvm::BasicBlock *, Var>,
+            llvm::WeakTrackingVH> defs_;
+    llvm::DenseSet<llvm::BasicBlock *> sealed_;
+    llvm::DenseMap<llvm::BasicBlock *,
+            std::vector<std::pair<Var, llvm::PHINode *>>> incomplete_phis_;
+};
+
+#endif // PL01_BACK_LLVM_SSA_H_
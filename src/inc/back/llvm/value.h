@@ -1,42 +1,55 @@
 #ifndef PL01_BACK_LLVM_VALUE_H_
 #define PL01_BACK_LLVM_VALUE_H_
 
-#include <memory>
-#include <map>
-#include <string>
+#include <vector>
+#include <cstdint>
+#include <cassert>
 
 #include <llvm/IR/Value.h>
+#include <llvm/IR/Function.h>
 
-class ValueTable;
-using VTPtr = std::shared_ptr<ValueTable>;
+#include <define/symbol.h>
 
+// values of symbols, indexed by bindings
+// scopes are reused by sibling procedures/functions, so no scope will
+// be allocated again after the deepest one has been reached
 class ValueTable {
 public:
-    ValueTable() {}
-    ValueTable(const VTPtr &table) : outer_(table) {}
+    void SetValue(const Binding &bind, llvm::Value *value) {
+        auto &values = GetScope(bind.depth).values;
+        if (bind.slot >= values.size()) values.resize(bind.slot + 1);
+        values[bind.slot] = value;
+    }
 
-    void AddValue(const std::string &id, llvm::Value *value) {
-        values_.insert({id, value});
+    llvm::Value *GetValue(const Binding &bind) const {
+        assert(bind.depth && bind.depth <= scopes_.size());
+        const auto &values = scopes_[bind.depth - 1].values;
+        return bind.slot < values.size() ? values[bind.slot] : nullptr;
     }
 
-    llvm::Value *GetValue(const std::string &id) {
-        auto it = values_.find(id);
-        if (it != values_.end()) {
-            return it->second;
-        }
-        else if (outer_) {
-            return outer_->GetValue(id);
-        }
-        else {
-            return nullptr;
-        }
+    // set the procedure/function that scope 'depth' belongs to
+    void SetFunction(std::uint32_t depth, llvm::Function *func) {
+        GetScope(depth).func = func;
     }
 
-    const VTPtr &outer() const { return outer_; }
+    llvm::Function *GetFunction(std::uint32_t depth) const {
+        assert(depth && depth <= scopes_.size());
+        return scopes_[depth - 1].func;
+    }
 
 private:
-    VTPtr outer_;
-    std::map<std::string, llvm::Value *> values_;
+    struct Scope {
+        llvm::Function *func = nullptr;
+        std::vector<llvm::Value *> values;
+    };
+
+    Scope &GetScope(std::uint32_t depth) {
+        assert(depth);
+        if (depth > scopes_.size()) scopes_.resize(depth);
+        return scopes_[depth - 1];
+    }
+
+    std::vector<Scope> scopes_;
 };
 
 #endif // PL01_BACK_LLVM_VALUE_H_
@@ -11,6 +11,7 @@
 #include <front/lexer.h>
 #include <front/analyzer.h>
 #include <define/symbol.h>
+#include <define/flatast.h>
 #include <back/irbuilder.h>
 #include <back/ir.h>
 
@@ -21,17 +22,28 @@ public:
     virtual void Dump(std::ostream &os = std::cerr) = 0;
     virtual SymbolType SemaAnalyze(Analyzer &ana) = 0;
     virtual IRPtr GenerateIR(IRBuilder &irb) = 0;
+    // append current AST to flat AST, return id of the new node
+    virtual FlatAST::NodeId Flatten(FlatAST &flat) = 0;
+    // semantic analysis of procedures/functions in two phases,
+    // declare it in current environment first, then analyze its body
+    // (maybe by another analyzer), used by parallel compilation
+    virtual SymbolType SemaDeclare(Analyzer &ana) {
+        return SymbolType::Error;
+    }
+    virtual SymbolType SemaAnalyzeBody(Analyzer &ana) {
+        return SymbolType::Error;
+    }
+    // value of constant expression, only available if 'SemaAnalyze'
+    // returns 'SymbolType::Const'
+    virtual int const_value() const { return 0; }
 
     unsigned int line_pos() const { return line_pos_; }
-    const EnvPtr &env() const { return env_; }
 
 protected:
     void set_line_pos(unsigned int line_pos) { line_pos_ = line_pos; }
-    void set_env(const EnvPtr &env) { env_ = env; }
 
 private:
     unsigned int line_pos_;
-    EnvPtr env_;
 };
 
 using ASTPtr = std::unique_ptr<BaseAST>;
@@ -51,6 +63,13 @@ public:
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
+
+    // getters
+    const ASTPtr &consts() const { return consts_; }
+    const ASTPtr &vars() const { return vars_; }
+    const ASTPtr &stat() const { return stat_; }
+    const ASTPtrList &proc_func() const { return proc_func_; }
 
 private:
     ASTPtr consts_, vars_, stat_;
@@ -60,48 +79,62 @@ private:
 class ConstsAST : public BaseAST {
 public:
     ConstsAST(VarDefList defs, unsigned int line_pos)
-            : defs_(std::move(defs)) {
+            : defs_(std::move(defs)), bind_{SymbolType::Error, 0, 0} {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
 
 private:
     VarDefList defs_;
+    // binding of the first definition, the rest are in the next slots
+    Binding bind_;
 };
 
 class VarsAST : public BaseAST {
 public:
     VarsAST(VarDefList defs, unsigned int line_pos)
-            : defs_(std::move(defs)) {
+            : defs_(std::move(defs)), bind_{SymbolType::Error, 0, 0} {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
 
 private:
     VarDefList defs_;
+    // binding of the first definition, the rest are in the next slots
+    Binding bind_;
 };
 
 class ProcedureAST : public BaseAST {
 public:
     ProcedureAST(const std::string &id, ASTPtr block,
             unsigned int line_pos)
-            : id_(id), block_(std::move(block)) {
+            : id_(id), block_(std::move(block)),
+              bind_{SymbolType::Error, 0, 0}, is_used_(true) {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
+    SymbolType SemaDeclare(Analyzer &ana) override;
+    SymbolType SemaAnalyzeBody(Analyzer &ana) override;
 
 private:
     std::string id_;
     ASTPtr block_;
+    Binding bind_;
+    CaptureList captures_;
+    // reachable from the main program, see 'Analyzer::ResolveUses'
+    bool is_used_;
 };
 
 class FunctionAST : public BaseAST {
@@ -109,34 +142,48 @@ public:
     FunctionAST(const std::string &id, IdList args,
             ASTPtr block, unsigned int line_pos)
             : id_(id), args_(std::move(args)),
-              block_(std::move(block)) {
+              block_(std::move(block)), bind_{SymbolType::Error, 0, 0},
+              is_used_(true) {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
+    SymbolType SemaDeclare(Analyzer &ana) override;
+    SymbolType SemaAnalyzeBody(Analyzer &ana) override;
 
 private:
     std::string id_;
     IdList args_;
     ASTPtr block_;
+    Binding bind_;
+    CaptureList captures_;
+    // reachable from the main program, see 'Analyzer::ResolveUses'
+    bool is_used_;
 };
 
 class AssignAST : public BaseAST {
 public:
     AssignAST(const std::string &id, ASTPtr expr, unsigned int line_pos)
-            : id_(id), expr_(std::move(expr)) {
+            : id_(id), expr_(std::move(expr)),
+              bind_{SymbolType::Error, 0, 0}, is_tail_(false) {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
 
 private:
     std::string id_;
     ASTPtr expr_;
+    // binding of the assigned symbol, resolved by 'SemaAnalyze'
+    Binding bind_;
+    // is a tail return, see 'Analyzer::IsTailReturn'
+    bool is_tail_;
 };
 
 class BeginEndAST : public BaseAST {
@@ -149,6 +196,7 @@ public:
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
 
 private:
     ASTPtrList stats_;
@@ -159,31 +207,38 @@ public:
     IfAST(ASTPtr cond, ASTPtr then, ASTPtr else_then,
             unsigned int line_pos)
             : cond_(std::move(cond)), then_(std::move(then)),
-              else_then_(std::move(else_then)) {
+              else_then_(std::move(else_then)), is_pruned_(false) {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
 
 private:
     ASTPtr cond_, then_, else_then_;
+    // condition is constant, the dead branch has been removed
+    bool is_pruned_;
 };
 
 class WhileAST : public BaseAST {
 public:
     WhileAST(ASTPtr cond, ASTPtr body, unsigned int line_pos)
-            : cond_(std::move(cond)), body_(std::move(body)) {
+            : cond_(std::move(cond)), body_(std::move(body)),
+              is_pruned_(false) {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
 
 private:
     ASTPtr cond_, body_;
+    // condition is constant false, the loop has been removed
+    bool is_pruned_;
 };
 
 class AsmAST : public BaseAST {
@@ -196,6 +251,7 @@ public:
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
 
 private:
     std::string asm_str_;
@@ -210,6 +266,7 @@ public:
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
 
 private:
     Lexer::Keyword type_;
@@ -218,65 +275,92 @@ private:
 class UnaryAST : public BaseAST {
 public:
     UnaryAST(Lexer::Keyword op, ASTPtr operand, unsigned int line_pos)
-            : op_(op), operand_(std::move(operand)) {
+            : op_(op), operand_(std::move(operand)), is_const_(false),
+              value_(0) {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
+    int const_value() const override { return value_; }
 
 private:
     Lexer::Keyword op_;     // 'odd' only
     ASTPtr operand_;
+    // folded value of constant expression
+    bool is_const_;
+    int value_;
 };
 
 class BinaryAST : public BaseAST {
 public:
     BinaryAST(Lexer::Operator op, ASTPtr lhs, ASTPtr rhs,
             unsigned int line_pos)
-            : op_(op), lhs_(std::move(lhs)), rhs_(std::move(rhs)) {
+            : op_(op), lhs_(std::move(lhs)), rhs_(std::move(rhs)),
+              is_const_(false), value_(0) {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
+    int const_value() const override { return value_; }
 
 private:
     Lexer::Operator op_;
     ASTPtr lhs_, rhs_;
+    // folded value of constant expression
+    bool is_const_;
+    int value_;
 };
 
 class FunCallAST : public BaseAST {
 public:
     FunCallAST(const std::string &id, ASTPtrList args,
             unsigned int line_pos)
-            : id_(id), args_(std::move(args)) {
+            : id_(id), args_(std::move(args)),
+              bind_{SymbolType::Error, 0, 0}, is_const_(false), value_(0) {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
+    int const_value() const override { return value_; }
 
 private:
     std::string id_;
     ASTPtrList args_;
+    Binding bind_;
+    // result of compile-time evaluation
+    bool is_const_;
+    int value_;
 };
 
 class IdAST : public BaseAST {
 public:
-    IdAST(const std::string &id, unsigned int line_pos) : id_(id) {
+    IdAST(const std::string &id, unsigned int line_pos)
+            : id_(id), bind_{SymbolType::Error, 0, 0}, is_const_(false),
+              value_(0) {
         set_line_pos(line_pos);
     }
 
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
+    int const_value() const override { return value_; }
 
 private:
     std::string id_;
+    Binding bind_;
+    // value of constant, or result of compile-time evaluation
+    bool is_const_;
+    int value_;
 };
 
 class NumberAST : public BaseAST {
@@ -288,6 +372,8 @@ public:
     void Dump(std::ostream &os) override;
     SymbolType SemaAnalyze(Analyzer &ana) override;
     IRPtr GenerateIR(IRBuilder &irb) override;
+    FlatAST::NodeId Flatten(FlatAST &flat) override;
+    int const_value() const override { return value_; }
 
 private:
     int value_;
@@ -0,0 +1,21 @@
+#ifndef PL01_DEFINE_ASTCACHE_H_
+#define PL01_DEFINE_ASTCACHE_H_
+
+#include <string>
+#include <cstdint>
+
+#include <define/flatast.h>
+
+// hash of source file, used to check if AST cache is out of date
+std::uint64_t HashSource(const std::string &source);
+// structural hash of the analyzed subtree 'id', symbols defined in
+// scope 'outer_depth' or outer scopes are hashed by names and types
+// only, so inserting definitions before them does not change the hash
+std::uint64_t HashSubtree(const FlatAST &ast, FlatAST::NodeId id,
+        std::uint32_t outer_depth);
+// load AST cache from file, return false if file is not a valid cache
+// or the hash of source file does not match
+bool LoadASTCache(const char *file, std::uint64_t hash, FlatAST &ast);
+bool SaveASTCache(const char *file, std::uint64_t hash, const FlatAST &ast);
+
+#endif // PL01_DEFINE_ASTCACHE_H_
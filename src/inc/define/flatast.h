@@ -0,0 +1,276 @@
+#ifndef PL01_DEFINE_FLATAST_H_
+#define PL01_DEFINE_FLATAST_H_
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <initializer_list>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+#include <define/type.h>
+#include <define/symbol.h>
+#include <front/lexer.h>
+#include <front/analyzer.h>
+#include <back/irbuilder.h>
+#include <back/ir.h>
+
+/*
+
+flat AST:
+    struct-of-arrays encoding of the AST, every node is an index into
+    several parallel arrays, children of a node are stored as a
+    contiguous range of 'children_', nodes are stored in post-order
+
+children of nodes:
+    Block:      consts, vars, stat, proc/func...
+    Consts:     Def...
+    Vars:       Def...
+    Def:        init
+    Procedure:  block
+    Function:   block, Def (argument)...
+    Assign:     expr
+    BeginEnd:   stat...
+    If:         cond, then, else-then
+    While:      cond, body
+    Unary:      operand
+    Binary:     lhs, rhs
+    FunCall:    arg...
+
+payload of nodes:
+    Def, Procedure, Function, Assign, FunCall, Id, Asm:
+                index of string table
+    Control, Unary:
+                keyword
+    Binary:     operator
+    Number:     value
+
+binding of nodes (available after 'SemaAnalyze'):
+    Def, Procedure, Function:
+                binding of the defined symbol
+    Assign, FunCall, Id:
+                binding of the referenced symbol
+
+flags of nodes (available after 'SemaAnalyze'):
+    Assign:     'kTailFlag' if it is a tail return
+    Procedure, Function:
+                'kUnusedFlag' if it is unreachable from the main program
+
+captured variables of nodes (available after 'SemaAnalyze'):
+    Procedure, Function:
+                stored in a side table, empty if there are none
+
+optional children (e.g. initializer of Def, else-then of If)
+are represented by 'kNullNode'
+
+rewriting (by 'SemaAnalyze'):
+    constant expressions (including calls of pure functions which
+    are evaluated at compile time) are folded into Number nodes,
+    If nodes with constant conditions, While nodes with constant false
+    conditions and BeginEnd nodes with unreachable statements are
+    rewritten into BeginEnd nodes which contain only the live children,
+    the dropped nodes stay in storage but are no longer reachable
+
+*/
+
+class FlatAST {
+public:
+    using NodeId = std::uint32_t;
+
+    enum class Kind : std::uint8_t {
+        Block, Consts, Vars, Def, Procedure, Function,
+        Assign, BeginEnd, If, While, Asm, Control,
+        Unary, Binary, FunCall, Id, Number
+    };
+
+    static constexpr NodeId kNullNode = static_cast<NodeId>(-1);
+    static constexpr std::uint8_t kTailFlag = 1;
+    static constexpr std::uint8_t kUnusedFlag = 2;
+
+    // range of child nodes
+    class Children {
+    public:
+        Children(const NodeId *begin, const NodeId *end)
+                : begin_(begin), end_(end) {}
+
+        const NodeId *begin() const { return begin_; }
+        const NodeId *end() const { return end_; }
+        std::size_t size() const { return end_ - begin_; }
+        NodeId operator[](std::size_t i) const { return begin_[i]; }
+
+    private:
+        const NodeId *begin_, *end_;
+    };
+
+    FlatAST() : root_(kNullNode) {}
+
+    // append a new node, return its id
+    NodeId AddNode(Kind kind, std::uint32_t payload, unsigned int line_pos,
+            std::initializer_list<NodeId> children);
+    NodeId AddNode(Kind kind, std::uint32_t payload, unsigned int line_pos,
+            const std::vector<NodeId> &children);
+    // intern a string, return index of string table
+    std::uint32_t AddString(const std::string &str);
+    void Clear();
+
+    // traverse all nodes in storage order
+    template <typename F>
+    void ForEachNode(F f) const {
+        for (NodeId i = 0; i < kinds_.size(); ++i) f(i);
+    }
+
+    // pre-order traversal with an explicit stack
+    // function 'f' returns false to skip the children of current node
+    template <typename F>
+    void Traverse(NodeId id, F f) const {
+        std::vector<NodeId> stack = {id};
+        while (!stack.empty()) {
+            auto cur = stack.back();
+            stack.pop_back();
+            if (cur == kNullNode || !f(cur)) continue;
+            auto c = children(cur);
+            for (auto it = c.end(); it != c.begin();) stack.push_back(*--it);
+        }
+    }
+
+    // binary serialization, see 'astcache.cpp' for the format
+    // 'hash' is the hash of source file
+    bool Save(std::ostream &os, std::uint64_t hash) const;
+    bool Load(const void *data, std::size_t size, std::uint64_t hash);
+
+    // passes, see 'Dump', 'SemaAnalyze' and 'GenerateIR' of 'BaseAST'
+    void Dump(std::ostream &os = std::cerr) const;
+    SymbolType SemaAnalyze(Analyzer &ana);
+    IRPtr GenerateIR(IRBuilder &irb) const { return GenerateIR(irb, root_); }
+    // generate IR of subtree 'id'
+    IRPtr GenerateIR(IRBuilder &irb, NodeId id) const;
+
+    // getters
+    NodeId root() const { return root_; }
+    std::size_t size() const { return kinds_.size(); }
+    Kind kind(NodeId id) const { return kinds_[id]; }
+    unsigned int line_pos(NodeId id) const { return lines_[id]; }
+    Children children(NodeId id) const {
+        auto begin = children_.data() + first_child_[id];
+        return Children(begin, begin + child_count_[id]);
+    }
+    NodeId child(NodeId id, std::size_t i) const {
+        assert(i < child_count_[id]);
+        return children_[first_child_[id] + i];
+    }
+    const std::string &name(NodeId id) const {
+        return strings_[payloads_[id]];
+    }
+    int value(NodeId id) const { return static_cast<int>(payloads_[id]); }
+    Lexer::Keyword keyword(NodeId id) const {
+        return static_cast<Lexer::Keyword>(payloads_[id]);
+    }
+    Lexer::Operator op(NodeId id) const {
+        return static_cast<Lexer::Operator>(payloads_[id]);
+    }
+    const Binding &binding(NodeId id) const { return bindings_[id]; }
+    bool is_tail(NodeId id) const { return flags_[id] & kTailFlag; }
+    bool is_used(NodeId id) const { return !(flags_[id] & kUnusedFlag); }
+    const CaptureList &captures(NodeId id) const {
+        static const CaptureList empty;
+        auto it = captures_.find(id);
+        return it != captures_.end() ? it->second : empty;
+    }
+
+    // setters
+    void set_root(NodeId root) { root_ = root; }
+    void set_binding(NodeId id, const Binding &bind) {
+        bindings_[id] = bind;
+    }
+    void set_tail(NodeId id, bool is_tail) {
+        if (is_tail) {
+            flags_[id] |= kTailFlag;
+        }
+        else {
+            flags_[id] &= ~kTailFlag;
+        }
+    }
+    void set_used(NodeId id, bool is_used) {
+        if (is_used) {
+            flags_[id] &= ~kUnusedFlag;
+        }
+        else {
+            flags_[id] |= kUnusedFlag;
+        }
+    }
+    // references are stable until 'Clear' is called
+    CaptureList &captures(NodeId id) { return captures_[id]; }
+    // rewrite node in place, only 'count' children starting from
+    // the 'begin'-th one are kept
+    void Rewrite(NodeId id, Kind kind, std::uint32_t payload,
+            std::size_t begin, std::size_t count) {
+        assert(begin + count <= child_count_[id]);
+        kinds_[id] = kind;
+        payloads_[id] = payload;
+        first_child_[id] += begin;
+        child_count_[id] = count;
+    }
+
+private:
+    NodeId root_;
+    // node table
+    std::vector<Kind> kinds_;
+    std::vector<std::uint32_t> payloads_, lines_;
+    std::vector<std::uint32_t> first_child_, child_count_;
+    std::vector<Binding> bindings_;
+    std::vector<std::uint8_t> flags_;
+    // captured variables of procedures/functions
+    std::unordered_map<NodeId, CaptureList> captures_;
+    // children of all nodes
+    std::vector<NodeId> children_;
+    // string table
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, std::uint32_t> string_ids_;
+};
+
+// visitor of flat AST, dispatch node by its kind
+// derived class must implement all 'VisitXXX' methods
+template <typename Derived, typename Ret>
+class FlatASTVisitor {
+public:
+    using NodeId = FlatAST::NodeId;
+    using Kind = FlatAST::Kind;
+
+    FlatASTVisitor(const FlatAST &ast) : ast_(ast) {}
+
+    Ret Visit(NodeId id) {
+        auto &self = static_cast<Derived &>(*this);
+        switch (ast_.kind(id)) {
+            case Kind::Block: return self.VisitBlock(id);
+            case Kind::Consts: return self.VisitConsts(id);
+            case Kind::Vars: return self.VisitVars(id);
+            case Kind::Def: return self.VisitDef(id);
+            case Kind::Procedure: return self.VisitProcedure(id);
+            case Kind::Function: return self.VisitFunction(id);
+            case Kind::Assign: return self.VisitAssign(id);
+            case Kind::BeginEnd: return self.VisitBeginEnd(id);
+            case Kind::If: return self.VisitIf(id);
+            case Kind::While: return self.VisitWhile(id);
+            case Kind::Asm: return self.VisitAsm(id);
+            case Kind::Control: return self.VisitControl(id);
+            case Kind::Unary: return self.VisitUnary(id);
+            case Kind::Binary: return self.VisitBinary(id);
+            case Kind::FunCall: return self.VisitFunCall(id);
+            case Kind::Id: return self.VisitId(id);
+            case Kind::Number: return self.VisitNumber(id);
+        }
+        // impossible situation
+        assert(false);
+        return Ret();
+    }
+
+protected:
+    const FlatAST &ast() const { return ast_; }
+
+private:
+    const FlatAST &ast_;
+};
+
+#endif // PL01_DEFINE_FLATAST_H_
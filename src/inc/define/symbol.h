@@ -1,53 +1,161 @@
 #ifndef PL01_DEFINE_SYMBOL_H_
 #define PL01_DEFINE_SYMBOL_H_
 
-#include <memory>
 #include <string>
-#include <map>
+#include <vector>
+#include <utility>
 #include <cstdint>
+#include <cstddef>
+#include <cassert>
 
 #include <define/type.h>
 
 struct SymbolInfo {
     SymbolType type;
     size_t func_arg_count;
+    int value;              // value of constant
 };
 
-class Environment;
-using EnvPtr = std::shared_ptr<Environment>;
+/*
 
-class Environment {
+binding of symbol:
+    resolved reference to a definition, 'depth' is the depth of
+    the scope that symbol defined in, 'slot' is the index of
+    the symbol in that scope (in definition order)
+
+scope of procedure/function arguments:
+    the scope right inside the scope of procedure/function itself,
+    always empty for procedures, for functions, slot 0 is the
+    return value, slot i (i > 0) is the i-th argument
+
+*/
+
+struct Binding {
+    SymbolType type;
+    std::uint32_t depth;
+    std::uint32_t slot;
+};
+
+// key of the definition that binding refers to,
+// unique among all visible definitions
+inline std::uint64_t GetBindingKey(const Binding &bind) {
+    return (static_cast<std::uint64_t>(bind.depth) << 32) | bind.slot;
+}
+
+/*
+
+captured variable:
+    variable (or return value) of an outer procedure/function, which
+    is used by a nested procedure/function or its callees, nested
+    procedures/functions are lifted to the top level, captured
+    variables are passed as extra arguments (after normal arguments,
+    in the order of 'CaptureList'), by reference if the variable is
+    modified by any nested procedure/function, otherwise by value
+
+*/
+
+struct Capture {
+    Binding bind;
+    bool by_ref;
+};
+
+using CaptureList = std::vector<Capture>;
+
+/*
+
+flat scoped symbol table:
+    all identifiers are interned into an open-addressing hash table,
+    every identifier has a stack of definitions (the innermost one is
+    on the top), definitions of all scopes are stored in one array
+    in definition order, so popping a scope just unlinks the tail of
+    the array, no memory will be allocated or freed per scope
+
+snapshot:
+    a symbol table can be created on top of another one, which must
+    not be modified during the lifetime of the new table, only the
+    first 'visible' definitions of the outer table can be found,
+    so procedures can be analyzed in parallel with their own tables
+
+*/
+
+class SymbolTable {
 public:
-    Environment() : outer_(nullptr) {}
-    Environment(const EnvPtr &outer) : outer_(outer) {}
+    SymbolTable()
+            : outer_(nullptr), visible_(0), base_depth_(0),
+              buckets_(kInitBucketCount, kNone) {}
+    SymbolTable(const SymbolTable &outer, std::size_t visible)
+            : outer_(&outer), visible_(visible), base_depth_(outer.depth()),
+              buckets_(kInitBucketCount, kNone) {}
 
-    void AddSymbol(const std::string &id, SymbolInfo info) {
-        symbols_.insert({id, info});
-    }
-    void AddClosureSymbol(const std::string &id) {
-        closure_symbols_.push_back(id);
+    void PushScope() { scopes_.push_back(defs_.size()); }
+    void PopScope();
+
+    // add symbol to current scope
+    void AddSymbol(const std::string &id, SymbolInfo info);
+    // add symbol to the scope outside current scope,
+    // current scope must be empty
+    void AddOuterSymbol(const std::string &id, SymbolInfo info);
+    // get the innermost visible definition of symbol
+    SymbolInfo GetInfo(const std::string &id) const;
+    // get binding of the innermost visible definition of symbol,
+    // or the definition in scope 'depth'
+    Binding GetBinding(const std::string &id) const {
+        return GetBinding(id, depth());
     }
-    SymbolInfo GetInfo(const std::string &id, bool recursive = true);
-
-    const EnvPtr &outer() const { return outer_; }
-    const IdList &closure_symbols() const { return closure_symbols_; }
-    bool is_root() const { return outer_ == nullptr; }
-    bool is_main() const { return outer_ && outer_->is_root(); }
-    bool in_global_body() const {
-        /*
-            var a, b;       <- main env
-            function func   <- main env
-                (x);        <- global function arg env
-                    var v;  <- global function body env
-        */
-        return outer_ && outer_->outer_ && outer_->outer_->is_main();
+    Binding GetBinding(const std::string &id, std::size_t depth) const;
+    // check if symbol is defined in current scope, or scope 'depth'
+    bool IsDefinedInScope(const std::string &id) const {
+        return IsDefinedInScope(id, depth());
     }
-    bool in_nested_body() const { return !is_main() && !in_global_body(); }
+    bool IsDefinedInScope(const std::string &id, std::size_t depth) const;
+
+    // depth of current scope (0 if there is no scope)
+    std::size_t depth() const { return base_depth_ + scopes_.size(); }
+    // count of all definitions in this table
+    std::size_t def_count() const { return defs_.size(); }
 
 private:
-    EnvPtr outer_;
-    std::map<std::string, SymbolInfo> symbols_;
-    IdList closure_symbols_;
+    static constexpr std::uint32_t kNone = static_cast<std::uint32_t>(-1);
+    static constexpr std::size_t kInitBucketCount = 64;
+
+    struct Ident {
+        std::string name;
+        std::size_t hash;
+        std::uint32_t top;      // index of the innermost definition
+    };
+
+    struct Definition {
+        std::uint32_t ident;
+        std::uint32_t prev;     // index of the shadowed definition
+        std::uint32_t depth;
+        SymbolInfo info;
+    };
+
+    // get index of identifier, 'kNone' if not found
+    std::uint32_t FindIdent(const std::string &id, std::size_t hash) const;
+    // get index of identifier, intern it if not found
+    std::uint32_t InternIdent(const std::string &id);
+    void InsertBucket(std::uint32_t index);
+    void Rehash();
+    // get the innermost definition of symbol in scope 'depth'
+    // or its outer scopes, whose index is less than 'limit'
+    // nullptr if not found
+    const Definition *GetDefinition(const std::string &id,
+            std::size_t hash, std::size_t depth, std::size_t limit) const;
+    // find definition in this table and the outer table
+    std::pair<const SymbolTable *, const Definition *> Lookup(
+            const std::string &id, std::size_t depth) const;
+    Binding MakeBinding(const Definition *def) const;
+
+    // outer table and count of its visible definitions
+    const SymbolTable *outer_;
+    std::size_t visible_, base_depth_;
+    // open addressing table, stores indices of 'idents_'
+    std::vector<std::uint32_t> buckets_;
+    std::vector<Ident> idents_;
+    std::vector<Definition> defs_;
+    // index of the first definition of each scope
+    std::vector<std::size_t> scopes_;
 };
 
 #endif // PL01_DEFINE_SYMBOL_H_
@@ -2,19 +2,41 @@
 #define PL01_FRONT_ANALYZER_H_
 
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <ostream>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
 
 #include <define/type.h>
 #include <define/symbol.h>
+#include <front/lexer.h>
+#include <front/ctfe.h>
 
 class Analyzer {
 public:
-    Analyzer() : env_(std::make_shared<Environment>()),
-            error_num_(0), while_count_(0) {}
-    Analyzer(const EnvPtr &env)
-            : env_(env), error_num_(0), while_count_(0) {}
+    Analyzer(std::ostream &err = std::cerr)
+            : outer_(nullptr), use_base_(0), uses_(1, nullptr), err_(err),
+              error_num_(0), while_count_(0), is_tail_(false),
+              is_reachable_(true) {
+        symbols_.PushScope();
+    }
+    // create an analyzer on top of the environment of analyzer 'outer',
+    // only the first 'visible' symbols of 'outer' are visible,
+    // 'outer' must not be modified until the new analyzer has finished
+    // its analysis, calls it recorded are merged by 'MergeUses'
+    // functions of 'outer' are not evaluated at compile time by it
+    Analyzer(const Analyzer &outer, std::size_t visible,
+            std::ostream &err = std::cerr)
+            : symbols_(outer.symbols_, visible), outer_(&outer),
+              use_base_(outer.use_base_ + outer.uses_.size()), err_(err),
+              error_num_(0), while_count_(0), is_tail_(false),
+              is_reachable_(true) {}
 
     SymbolType AnalyzeConst(const std::string &id, SymbolType init,
-            unsigned int line_pos);
+            int value, unsigned int line_pos);
     SymbolType AnalyzeVar(const std::string &id, unsigned int line_pos);
     SymbolType AnalyzeVar(const std::string &id, SymbolType init,
             unsigned int line_pos);
@@ -22,6 +44,9 @@ public:
             unsigned int line_pos);
     SymbolType AnalyzeFunction(const std::string &id, const IdList &args,
             unsigned int line_pos);
+    // add return value and arguments of function to current environment
+    SymbolType AnalyzeFunctionArgs(const std::string &id,
+            const IdList &args, unsigned int line_pos);
     SymbolType AnalyzeAssign(const std::string &id, SymbolType expr_type,
             unsigned int line_pos);
     SymbolType AnalyzeControl(unsigned int line_pos);
@@ -31,13 +56,77 @@ public:
     SymbolType AnalyzeFunCall(const std::string &id, const TypeList &args,
             unsigned int line_pos);
     SymbolType AnalyzeId(const std::string &id, unsigned int line_pos);
+    SymbolType AnalyzeAsm();
+
+    // evaluate constant expressions in the same way as the generated
+    // code (32-bit two's complement, comparisons yield 0 or 1),
+    // store the result to 'value', undefined results (division by zero
+    // or overflow) are not folded, 'SymbolType::Var' is returned for them
+    SymbolType EvalUnary(Lexer::Keyword op, int operand, int &value,
+            unsigned int line_pos);
+    SymbolType EvalBinary(Lexer::Operator op, int lhs, int rhs, int &value,
+            unsigned int line_pos);
+    // evaluate call of pure function 'id' with constant arguments,
+    // returns 'SymbolType::Const' if succeeded, see 'Evaluator'
+    SymbolType EvalFunCall(const std::string &id,
+            const std::vector<int> &args, int &value);
+
+    // enter/exit the body of procedure/function 'bind', variables it
+    // captures are stored to 'captures' when exiting the outermost one,
+    // whether it is reachable is stored to 'is_used' by 'ResolveUses'
+    void EnterFunction(const Binding &bind, CaptureList &captures,
+            bool &is_used);
+    // declare procedure/function 'bind' for reachability analysis
+    // before its body is analyzed (maybe by another analyzer)
+    void DeclareFunction(const Binding &bind, bool &is_used);
+    void ExitFunction();
+    bool in_function() const { return !func_stack_.empty(); }
+    // check if current function is pure so far, i.e. it only accesses
+    // its own arguments and local variables, and only calls itself or
+    // other pure functions, see 'Evaluator'
+    bool IsPureFunction() const;
+    // pure functions are compiled by it after their bodies are analyzed
+    IRBuilder &evaluator() { return evaluator_; }
 
-    void NewEnvironment() { env_ = std::make_shared<Environment>(env_); }
-    void RestoreEnvironment() { env_ = env_->outer(); }
+    void NewEnvironment() { symbols_.PushScope(); }
+    void RestoreEnvironment() { symbols_.PopScope(); }
     void EnterWhile() { ++while_count_; }
     void ExitWhile() { --while_count_; }
 
-    const EnvPtr &env() const { return env_; }
+    // statement in tail position is the last one executed before
+    // returning from current function, loop bodies never are
+    bool is_tail() const { return is_tail_; }
+    void set_tail(bool is_tail) { is_tail_ = is_tail; }
+    // check if assignment to 'id' is a tail return, i.e. assigning
+    // the return value of current function in tail position
+    bool IsTailReturn(const std::string &id) const;
+
+    // whether the end of current statement is reachable, statements
+    // after 'break'/'continue' are not, set it before every statement
+    bool is_reachable() const { return is_reachable_; }
+    void set_reachable(bool is_reachable) { is_reachable_ = is_reachable; }
+
+    // calls of procedures/functions recorded so far, the ones in code
+    // removed by dead code elimination must be removed by 'RemoveCalls'
+    std::size_t call_count() const { return calls_.size(); }
+    void RemoveCalls(std::size_t begin, std::size_t end) {
+        calls_.erase(calls_.begin() + begin, calls_.begin() + end);
+    }
+    // append procedures/functions and calls recorded by analyzer
+    // 'inner' created on top of current one, in source order
+    void MergeUses(const Analyzer &inner);
+    // find procedures/functions reachable from the main program through
+    // the recorded calls, called by the outermost analyzer after the
+    // whole program is analyzed, while all the 'is_used' flags are
+    // still alive
+    void ResolveUses();
+
+    // get binding of procedure/function in its arguments environment
+    Binding GetOuterBinding(const std::string &id) const {
+        return symbols_.GetBinding(id, symbols_.depth() - 1);
+    }
+
+    const SymbolTable &symbols() const { return symbols_; }
     unsigned int error_num() const { return error_num_; }
 
 private:
@@ -45,11 +134,48 @@ private:
     SymbolType PrintError(const char *message, const char *id,
             unsigned int line_pos);
     SymbolType IsIdDefined(const std::string &id, unsigned int line_pos);
-    SymbolInfo RecursiveQuery(const std::string &id);
+    // record reference of symbol in current procedure/function
+    void AddReference(const std::string &id, bool is_write);
+    // compute captured variables of all procedures/functions
+    void ResolveCaptures();
+    // index of current procedure/function in 'uses_'
+    std::size_t GetCaller() const;
+    // find index of procedure/function by binding key,
+    // in current analyzer and then the outer ones
+    bool FindUseId(std::uint64_t key, std::size_t &use_id) const;
+    // get flag of procedure/function by index
+    bool *GetUse(std::size_t use_id) const;
+
+    // procedure/function for capture analysis
+    struct FuncNode {
+        std::uint32_t arg_depth;    // depth of arguments scope
+        std::size_t use_id;         // index in 'uses_'
+        CaptureList *captures;
+        bool is_pure;
+        std::vector<Binding> reads, writes;
+        std::vector<std::size_t> callees, children;
+    };
 
-    EnvPtr env_;
+    SymbolTable symbols_;
+    // procedures/functions in the current outermost one
+    std::vector<FuncNode> funcs_;
+    std::vector<std::size_t> func_stack_;
+    // binding key of procedure/function (or its return value) to node
+    std::unordered_map<std::uint64_t, std::size_t> func_ids_;
+    // call graph of the whole program for reachability analysis,
+    // flags of all procedures/functions (index 0 is the main program),
+    // binding key to index, and calls (caller, callee) in order,
+    // indices less than 'use_base_' belong to the outer analyzers
+    const Analyzer *outer_;
+    std::size_t use_base_;
+    std::vector<bool *> uses_;
+    std::unordered_map<std::uint64_t, std::size_t> use_ids_;
+    std::vector<std::pair<std::size_t, std::size_t>> calls_;
+    Evaluator evaluator_;
+    std::ostream &err_;
     unsigned int error_num_;
     int while_count_;
+    bool is_tail_, is_reachable_;
 };
 
 #endif // PL01_FRONT_ANALYZER_H_
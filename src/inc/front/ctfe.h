@@ -0,0 +1,151 @@
+#ifndef PL01_FRONT_CTFE_H_
+#define PL01_FRONT_CTFE_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+#include <define/type.h>
+#include <define/symbol.h>
+#include <front/lexer.h>
+#include <back/irbuilder.h>
+#include <back/ir.h>
+
+/*
+
+compile-time function evaluation (CTFE):
+    pure functions (which only access their own arguments and local
+    variables, and only call pure functions) are compiled into a
+    stack bytecode through the 'IRBuilder' interface once they have
+    been analyzed, calls of them with constant arguments are then
+    interpreted, so that the results can be used as constants
+
+bytecode:
+    expressions leave their values on the operand stack, so IR handles
+    are only non-null markers, every call has a frame of local slots,
+    slot 0 is the return value, followed by arguments and variables
+
+budgets:
+    an evaluation fails if it executes more than 'kMaxSteps'
+    instructions, nests more than 'kMaxDepth' calls, or divides by
+    zero (or overflows), such calls are left to run time, results and
+    failures are cached, so repeated calls with the same arguments
+    are interpreted only once
+
+*/
+
+class Evaluator : public IRBuilder {
+public:
+    Evaluator() : cur_func_(kNone), arg_depth_(0), failed_(false) {}
+
+    IRPtr GenerateBlock(LazyIRGen consts, LazyIRGen vars,
+            LazyIRGen proc_func, LazyIRGen stat) override;
+    IRPtr GenerateConst(const std::string &id, const Binding &bind,
+            const IRPtr &expr) override;
+    IRPtr GenerateVar(const std::string &id, const Binding &bind,
+            const IRPtr &init) override;
+    IRPtr GenerateProcedure(const std::string &id, const Binding &bind,
+            const CaptureList &captures, LazyIRGen block) override;
+    IRPtr GenerateFunction(const std::string &id, const Binding &bind,
+            const IdList &args, const CaptureList &captures,
+            LazyIRGen block) override;
+    IRPtr GenerateAssign(const Binding &bind, const IRPtr &expr,
+            bool is_tail) override;
+    IRPtr GenerateIf(const IRPtr &cond, LazyIRGen then,
+            LazyIRGen else_then) override;
+    IRPtr GenerateWhile(LazyIRGen cond, LazyIRGen body) override;
+    IRPtr GenerateAsm(const std::string &asm_str) override;
+    IRPtr GenerateControl(Lexer::Keyword type) override;
+    IRPtr GenerateUnary(const IRPtr &operand) override;
+    IRPtr GenerateBinary(Lexer::Operator op,
+            const IRPtr &lhs, const IRPtr &rhs) override;
+    IRPtr GenerateFunCall(const Binding &bind,
+            const IRPtrList &args) override;
+    IRPtr GenerateId(const Binding &bind) override;
+    IRPtr GenerateNumber(int value) override;
+
+    // forget the function defined by 'bind', it is shadowed by
+    // a new definition with the same binding
+    void RemoveFunction(const Binding &bind);
+    // check if function 'bind' has been compiled
+    bool HasFunction(const Binding &bind) const;
+    // evaluate binary operator in the same way as the generated code,
+    // returns false if the result is undefined (division by zero or
+    // overflow), also used by constant folding of 'Analyzer'
+    static bool EvalBinary(Lexer::Operator op, int lhs, int rhs,
+            int &value);
+    // evaluate a call of function 'bind', returns false if failed
+    // results (and failures) are cached per function and arguments
+    bool Call(const Binding &bind, const std::vector<int> &args, int &ret);
+
+private:
+    static constexpr std::size_t kNone = static_cast<std::size_t>(-1);
+    static constexpr std::size_t kMaxSteps = 1 << 20;
+    static constexpr std::size_t kMaxDepth = 1 << 12;
+
+    enum class Op : std::uint8_t {
+        Push, Load, Store, Jump, JumpZero, Call, Ret, Odd,
+        Add, Sub, Mul, Div, Less, LessEqual, Great, GreatEqual,
+        NotEqual, Equal
+    };
+
+    struct Inst {
+        Op op;
+        std::int32_t operand;
+    };
+
+    struct Function {
+        std::size_t entry;
+        std::uint32_t arg_count, frame_size;
+    };
+
+    // cached result of a call
+    struct CallResult {
+        bool succeeded;
+        int value;
+    };
+
+    // loop being compiled, for break/continue
+    struct Loop {
+        std::size_t cond;
+        std::vector<std::size_t> breaks;
+    };
+
+    // index of instruction that will be emitted next
+    std::size_t pc() const { return code_.size(); }
+    void Emit(Op op, std::int32_t operand = 0) {
+        code_.push_back({op, operand});
+    }
+    // make jump at 'inst' go to current position
+    void Patch(std::size_t inst) { code_[inst].operand = pc(); }
+    // slot of local symbol in frame of current function
+    std::int32_t GetSlot(const Binding &bind);
+    // emit call of function 'bind', arguments are on the stack
+    IRPtr EmitCall(const Binding &bind);
+    IRPtr MakeIR() { return IRPtr(this); }
+    // run function 'funcs_[func]' with 'args', returns false if failed
+    bool Interpret(std::size_t func, const std::vector<int> &args,
+            int &ret) const;
+    // get bytecode of binary operator, returns false if not supported
+    static bool GetBinaryOp(Lexer::Operator op, Op &bin_op);
+    // evaluate binary operator, returns false if failed
+    static bool EvalBinary(Op op, int lhs, int rhs, int &value);
+
+    std::vector<Inst> code_;
+    std::vector<Function> funcs_;
+    // binding key of function to index of 'funcs_'
+    std::unordered_map<std::uint64_t, std::size_t> func_ids_;
+    // index of function and arguments to result of the call
+    std::map<std::pair<std::size_t, std::vector<int>>, CallResult> memo_;
+    // state of the function being compiled
+    std::size_t cur_func_;
+    std::uint32_t arg_depth_;
+    bool failed_;
+    std::vector<Loop> loops_;
+};
+
+#endif // PL01_FRONT_CTFE_H_
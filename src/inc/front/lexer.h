@@ -2,6 +2,8 @@
 #define PL01_FRONT_LEXER_H_
 
 #include <istream>
+#include <ostream>
+#include <iostream>
 #include <string>
 
 class Lexer {
@@ -24,8 +26,9 @@ public:
         NotEqual, Equal, Assign
     };
 
-    Lexer(std::istream &in)
-            : in_(in), line_pos_(1), error_num_(0), last_char_(' ') {
+    Lexer(std::istream &in, std::ostream &err = std::cerr)
+            : in_(in), err_(err), line_pos_(1), error_num_(0),
+              last_char_(' ') {
         in_ >> std::noskipws;
     }
 
@@ -36,6 +39,8 @@ public:
         last_char_ = ' ';
     }
 
+    // stream for printing error messages of current source file
+    std::ostream &err() const { return err_; }
     unsigned int line_pos() const { return line_pos_; }
     unsigned int error_num() const { return error_num_; }
     const std::string &id_val() const { return id_val_; }
@@ -59,9 +64,10 @@ private:
     Token HandleEOL();
 
     std::istream &in_;
+    std::ostream &err_;
     unsigned int line_pos_, error_num_;
     char last_char_;
-    std::string id_val_, str_val_;
+    std::string id_val_, str_val_, num_buf_;
     int num_val_;
     Keyword key_val_;
     Operator op_val_;
@@ -32,22 +32,42 @@ muldiv      ::= "*" | "/";
 
 */
 
+#include <memory>
+#include <utility>
+#include <string>
+#include <vector>
+#include <cstddef>
+
 #include <front/lexer.h>
 #include <define/ast.h>
 
 class Parser {
 public:
-    Parser(Lexer &lexer) : lexer_(lexer), error_num_(0) {
+    // in recognizer mode, parser only checks the syntax of source
+    // without building any AST, all parsing methods return nullptr
+    // so 'error_num' should be used to check the result
+    // expressions are still parsed with an explicit stack, which holds
+    // a frame for every level of parentheses and function calls, so
+    // its memory grows with nesting depth (but not with length)
+    Parser(Lexer &lexer, bool recognize_only = false)
+            : lexer_(lexer), recognize_only_(recognize_only), error_num_(0) {
         NextToken();
     }
 
     ASTPtr ParseProgram();
+    // streaming interface, parse the block of program part by part
+    // return nullptr if the part does not exist (or error occurred)
+    ASTPtr ParseGlobalConsts();
+    ASTPtr ParseGlobalVars();
+    ASTPtr ParseGlobalProcFunc();   // call repeatedly until nullptr
+    ASTPtr ParseMainStatement();    // also check the ending '.'
     void Reset() {
         lexer_.Reset();
         error_num_ = 0;
         NextToken();
     }
 
+    bool recognize_only() const { return recognize_only_; }
     unsigned int error_num() const { return error_num_; }
 
 private:
@@ -55,6 +75,29 @@ private:
     using Keyword = Lexer::Keyword;
     using Operator = Lexer::Operator;
 
+    // operand of an operator chain
+    struct ChainOperand {
+        Operator op;    // operator before current operand
+        ASTPtr operand;
+        unsigned int line_pos;
+    };
+
+    using OperandList = std::vector<ChainOperand>;
+
+    enum class FrameType { Chain, Paren, Call };
+
+    // element of the stack of expression parser
+    struct ExprFrame {
+        FrameType type;
+        unsigned int line_pos;
+        // 'Chain' only: operands and the operator waiting for its rhs
+        OperandList chain;
+        Operator pending;
+        // 'Call' only: id of function and arguments
+        std::string id;
+        ASTPtrList args;
+    };
+
     Token NextToken() { return cur_token_ = lexer_.NextToken(); }
     bool IsTokenChar(char c) const {
         return cur_token_ == Token::Char && lexer_.char_val() == c;
@@ -85,6 +128,13 @@ private:
                 || lexer_.op_val() == Operator::Div);
     }
 
+    // create a new AST node, return nullptr in recognizer mode
+    template <typename T, typename... Args>
+    ASTPtr MakeAST(Args &&... args) {
+        if (recognize_only_) return nullptr;
+        return std::make_unique<T>(std::forward<Args>(args)...);
+    }
+
     ASTPtr PrintError(const char *message);
     ASTPtr ParseBlock();
     ASTPtr ParseConstants();
@@ -101,12 +151,20 @@ private:
     ASTPtr ParseControl();
     ASTPtr ParseCondition();
     ASTPtr ParseExpression();
-    ASTPtr ParseTerm();
-    ASTPtr ParseFactor();
+
+    // helpers of 'ParseExpression', operate on the stack 'frames_'
+    static ASTPtr BuildChain(OperandList &chain, std::size_t begin,
+            std::size_t end, bool flip);
+    void ReduceChain(ASTPtr &cur);
+    void ReduceChains(ASTPtr &cur);
+    void PushOperator(ASTPtr &cur, Operator op, unsigned int line_pos);
 
     Lexer &lexer_;
+    bool recognize_only_;
     unsigned int error_num_;
     Token cur_token_;
+    // stack of 'ParseExpression', kept to reuse its storage
+    std::vector<ExprFrame> frames_;
 };
 
 #endif // PL01_FRONT_PARSER_H_
@@ -1,6 +1,422 @@
-#include <lexer.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+#include <cstddef>
+
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <front/lexer.h>
+#include <front/parser.h>
+#include <front/analyzer.h>
+#include <define/ast.h>
+#include <define/flatast.h>
+#include <define/astcache.h>
+#include <back/llvm/builder.h>
+#include <back/llvm/parallel.h>
+#include <back/llvm/incremental.h>
+#include <back/llvm/linker.h>
+
+namespace {
+
+struct Options {
+    const char *input = nullptr;
+    std::vector<const char *> inputs;
+    const char *ast_cache = nullptr;
+    const char *func_cache = nullptr;
+    std::string output;
+    std::string runtime;
+    bool dump_ast = false;
+    bool dump_ir = false;
+    bool stream = false;
+    bool syntax_only = false;
+    bool link = false;
+    bool remarks = false;
+    // 0 means number of hardware threads for '--syntax-only' and
+    // '--func-cache', other modes compile in current thread by default
+    unsigned int jobs = 0;
+    unsigned int opt_budget = 0;  // 0 means unlimited
+    SizeLevel size_level = SizeLevel::None;
+    LinkMode link_mode = LinkMode::Dynamic;
+};
+
+void PrintUsage(const char *app) {
+    std::cout << APP_NAME << " compiler version " << APP_VERSION;
+    std::cout << std::endl << std::endl;
+    std::cout << "usage: " << app << " [options] <input>" << std::endl;
+    std::cout << "       " << app << " --syntax-only [-j <n>] <input>..."
+              << std::endl;
+    std::cout << std::endl << "options:" << std::endl;
+    std::cout << "  -o <file>     write object to <file>" << std::endl;
+    std::cout << "  --link        link object with runtime library by a"
+              << std::endl;
+    std::cout << "                single 'cc' command, write executable"
+              << std::endl;
+    std::cout << "                to <file> of '-o'" << std::endl;
+    std::cout << "  --runtime <file>" << std::endl;
+    std::cout << "                path of runtime library for '--link'"
+              << std::endl;
+    std::cout << "  --static      link a static executable, which has the"
+              << std::endl;
+    std::cout << "                fastest startup" << std::endl;
+    std::cout << "  --static-pie  generate position independent code, link"
+              << std::endl;
+    std::cout << "                a static position independent executable"
+              << std::endl;
+    std::cout << "  --dump-ast    dump AST to stderr" << std::endl;
+    std::cout << "  --dump-ir     dump LLVM IR to stderr" << std::endl;
+    std::cout << "  --stream      compile procedures/functions one by one,"
+              << std::endl;
+    std::cout << "                free their ASTs after code generation"
+              << std::endl;
+    std::cout << "  --ast-cache <file>" << std::endl;
+    std::cout << "                load analyzed AST from <file> if source"
+              << std::endl;
+    std::cout << "                is unchanged, otherwise update <file>"
+              << std::endl;
+    std::cout << "  --func-cache <dir>" << std::endl;
+    std::cout << "                cache object of every procedure/function"
+              << std::endl;
+    std::cout << "                in <dir>, only compile the changed ones,"
+              << std::endl;
+    std::cout << "                object will be an archive of them"
+              << std::endl;
+    std::cout << "  --syntax-only check syntax of all inputs in parallel,"
+              << std::endl;
+    std::cout << "                do not build AST or generate object"
+              << std::endl;
+    std::cout << "  -j <n>        use <n> threads, compile procedures/functions"
+              << std::endl;
+    std::cout << "                in parallel if <n> is greater than 1,"
+              << std::endl;
+    std::cout << "                object will be an archive of <n> objects"
+              << std::endl;
+    std::cout << "  --opt-budget <ms>" << std::endl;
+    std::cout << "                stop optimizing a procedure/function after"
+              << std::endl;
+    std::cout << "                <ms> milliseconds" << std::endl;
+    std::cout << "  -Os           optimize for size, merge identical"
+              << std::endl;
+    std::cout << "                procedures/functions, emit every function"
+              << std::endl;
+    std::cout << "                into its own section, unused ones are"
+              << std::endl;
+    std::cout << "                removed by '--link'" << std::endl;
+    std::cout << "  -Oz           like -Os, also outline repeated code"
+              << std::endl;
+    std::cout << "  -Rpass        report optimizations (e.g. tail calls)"
+              << std::endl;
+    std::cout << "  -h, --help    display this message" << std::endl;
+}
+
+bool ParseArguments(int argc, const char *argv[], Options &opts) {
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "-o")) {
+            if (++i >= argc) return false;
+            opts.output = argv[i];
+        }
+        else if (!std::strcmp(argv[i], "--dump-ast")) {
+            opts.dump_ast = true;
+        }
+        else if (!std::strcmp(argv[i], "--dump-ir")) {
+            opts.dump_ir = true;
+        }
+        else if (!std::strcmp(argv[i], "--link")) {
+            opts.link = true;
+        }
+        else if (!std::strcmp(argv[i], "--runtime")) {
+            if (++i >= argc) return false;
+            opts.runtime = argv[i];
+        }
+        else if (!std::strcmp(argv[i], "--static")) {
+            opts.link_mode = LinkMode::Static;
+        }
+        else if (!std::strcmp(argv[i], "--static-pie")) {
+            opts.link_mode = LinkMode::StaticPIE;
+        }
+        else if (!std::strcmp(argv[i], "--stream")) {
+            opts.stream = true;
+        }
+        else if (!std::strcmp(argv[i], "--ast-cache")) {
+            if (++i >= argc) return false;
+            opts.ast_cache = argv[i];
+        }
+        else if (!std::strcmp(argv[i], "--func-cache")) {
+            if (++i >= argc) return false;
+            opts.func_cache = argv[i];
+        }
+        else if (!std::strcmp(argv[i], "--opt-budget")) {
+            if (++i >= argc) return false;
+            auto budget = std::atoi(argv[i]);
+            if (budget <= 0) return false;
+            opts.opt_budget = budget;
+        }
+        else if (!std::strcmp(argv[i], "-Os")) {
+            opts.size_level = SizeLevel::Small;
+        }
+        else if (!std::strcmp(argv[i], "-Oz")) {
+            opts.size_level = SizeLevel::Smallest;
+        }
+        else if (!std::strcmp(argv[i], "-Rpass")) {
+            opts.remarks = true;
+        }
+        else if (!std::strcmp(argv[i], "--syntax-only")) {
+            opts.syntax_only = true;
+        }
+        else if (!std::strcmp(argv[i], "-j")) {
+            if (++i >= argc) return false;
+            auto jobs = std::atoi(argv[i]);
+            if (jobs <= 0) return false;
+            opts.jobs = jobs;
+        }
+        else if (argv[i][0] == '-') {
+            return false;
+        }
+        else {
+            opts.inputs.push_back(argv[i]);
+        }
+    }
+    if (opts.inputs.empty()) return false;
+    opts.input = opts.inputs.front();
+    if (opts.syntax_only) return true;
+    if (opts.inputs.size() > 1
+            || (opts.stream && (opts.ast_cache || opts.func_cache))) {
+        return false;
+    }
+    // get default output file name
+    if (opts.output.empty()) {
+        opts.output = opts.input;
+        auto pos = opts.output.rfind('.');
+        if (pos != std::string::npos) opts.output.erase(pos);
+        if (!opts.link) opts.output += ".o";
+    }
+    if (opts.link && opts.runtime.empty()) {
+        opts.runtime = GetDefaultRuntime(argv[0]);
+    }
+    return true;
+}
+
+// set options of optimizations, except the number of threads
+void InitBuilder(LLVMIRBuilder &irb, const Options &opts) {
+    irb.set_opt_budget(opts.opt_budget);
+    irb.set_size_level(opts.size_level);
+    irb.set_remarks(opts.remarks);
+    irb.set_pic(opts.link_mode == LinkMode::StaticPIE);
+}
+
+// write object to output file, or link it into an executable in memory,
+// 'compile' writes the object to the stream
+int WriteOutput(const Options &opts,
+        const std::function<bool(llvm::raw_pwrite_stream &)> &compile) {
+    if (!opts.link) {
+        std::error_code ec;
+        llvm::raw_fd_ostream os(opts.output, ec);
+        if (ec) {
+            std::cerr << "could not open file '" << opts.output << "': ";
+            std::cerr << ec.message() << std::endl;
+            return 1;
+        }
+        return compile(os) ? 0 : 1;
+    }
+    llvm::SmallVector<char, 0> buffer;
+    llvm::raw_svector_ostream os(buffer);
+    if (!compile(os)) return 1;
+    llvm::StringRef object(buffer.data(), buffer.size());
+    auto linked = LinkExecutable(object, opts.runtime, opts.output,
+            opts.link_mode, opts.size_level);
+    return linked ? 0 : 1;
+}
+
+int EmitObject(LLVMIRBuilder &irb, const Options &opts) {
+    irb.FinishModule();
+    if (opts.dump_ir) irb.Dump();
+    return WriteOutput(opts, [&](llvm::raw_pwrite_stream &os) {
+        return irb.CompileToObject(os);
+    });
+}
+
+int CompileProgram(Parser &parser, const Options &opts) {
+    // parse the whole program
+    auto ast = parser.ParseProgram();
+    if (!ast) return 1;
+    if (opts.dump_ast) ast->Dump();
+    LLVMIRBuilder irb(opts.input);
+    irb.set_jobs(opts.jobs);
+    InitBuilder(irb, opts);
+    if (opts.jobs > 1) {
+        // analyze and compile procedures/functions in parallel
+        auto &program = static_cast<BlockAST &>(*ast);
+        if (!CompileParallel(program, irb, opts.jobs)) return 1;
+        return EmitObject(irb, opts);
+    }
+    // semantic analysis
+    Analyzer ana;
+    ast->SemaAnalyze(ana);
+    if (ana.error_num()) return 1;
+    // generate IR
+    ast->GenerateIR(irb);
+    return EmitObject(irb, opts);
+}
+
+// streaming mode, every procedure/function is parsed, analyzed
+// and compiled before the next one is parsed,
+// so only one of them has AST in memory at the same time
+int CompileStreaming(Parser &parser, const Options &opts) {
+    Analyzer ana;
+    LLVMIRBuilder irb(opts.input);
+    irb.set_jobs(opts.jobs);
+    InitBuilder(irb, opts);
+    auto is_failed = [&] { return parser.error_num() || ana.error_num(); };
+    auto analyze = [&](const ASTPtr &ast) {
+        if (!ast || is_failed()) return false;
+        if (opts.dump_ast) ast->Dump();
+        ast->SemaAnalyze(ana);
+        return !is_failed();
+    };
+    // constants and variables of main block
+    ana.NewEnvironment();
+    auto consts = parser.ParseGlobalConsts();
+    analyze(consts);
+    auto vars = parser.ParseGlobalVars();
+    analyze(vars);
+    if (is_failed()) return 1;
+    // generate main block, parse the rest parts lazily
+    auto consts_gen = [&] { return consts->GenerateIR(irb); };
+    auto vars_gen = [&] { return vars->GenerateIR(irb); };
+    irb.GenerateBlock(consts ? LazyIRGen(consts_gen) : nullptr,
+            vars ? LazyIRGen(vars_gen) : nullptr, [&] {
+        while (!is_failed()) {
+            auto proc_func = parser.ParseGlobalProcFunc();
+            if (analyze(proc_func)) proc_func->GenerateIR(irb);
+            if (!proc_func) break;
+        }
+        return nullptr;
+    }, [&] {
+        if (is_failed()) return nullptr;
+        auto stat = parser.ParseMainStatement();
+        if (analyze(stat)) stat->GenerateIR(irb);
+        return nullptr;
+    });
+    if (is_failed()) return 1;
+    return EmitObject(irb, opts);
+}
+
+// compile with AST cache and/or function cache, skip parsing and
+// semantic analysis if source file has not been changed since the
+// AST cache was created, see 'CompileIncremental' for function cache
+int CompileCached(const std::string &source, const Options &opts) {
+    auto hash = HashSource(source);
+    FlatAST ast;
+    if (!opts.ast_cache || !LoadASTCache(opts.ast_cache, hash, ast)) {
+        // parse source file
+        std::istringstream iss(source);
+        Lexer lexer(iss);
+        Parser parser(lexer);
+        auto program = parser.ParseProgram();
+        if (!program) return 1;
+        ast.set_root(program->Flatten(ast));
+        program.reset();
+        // semantic analysis
+        Analyzer ana;
+        ast.SemaAnalyze(ana);
+        if (ana.error_num()) return 1;
+        // update cache
+        if (opts.ast_cache && !SaveASTCache(opts.ast_cache, hash, ast)) {
+            std::cerr << "could not write AST cache '" << opts.ast_cache;
+            std::cerr << "'" << std::endl;
+        }
+    }
+    if (opts.dump_ast) ast.Dump();
+    if (opts.func_cache) {
+        auto jobs = opts.jobs ? opts.jobs
+                              : std::thread::hardware_concurrency();
+        auto init = [&](LLVMIRBuilder &irb) { InitBuilder(irb, opts); };
+        return WriteOutput(opts, [&](llvm::raw_pwrite_stream &os) {
+            return CompileIncremental(ast, opts.func_cache, os, jobs, init);
+        });
+    }
+    // generate IR
+    LLVMIRBuilder irb(opts.input);
+    irb.set_jobs(opts.jobs);
+    InitBuilder(irb, opts);
+    ast.GenerateIR(irb);
+    return EmitObject(irb, opts);
+}
+
+// check syntax of source file, write error messages to 'err'
+bool CheckSyntax(const char *file, std::ostream &err) {
+    std::ifstream ifs(file);
+    if (!ifs.is_open()) {
+        err << "could not open file '" << file << "'" << std::endl;
+        return false;
+    }
+    Lexer lexer(ifs, err);
+    Parser parser(lexer, true);
+    parser.ParseProgram();
+    return !lexer.error_num() && !parser.error_num();
+}
+
+// check syntax of all input files in parallel
+// error messages of each file are buffered and printed together
+int CheckSyntaxAll(const Options &opts) {
+    std::atomic<std::size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::mutex err_lock;
+    auto worker = [&] {
+        std::ostringstream err;
+        for (auto i = next++; i < opts.inputs.size(); i = next++) {
+            err.str("");
+            if (CheckSyntax(opts.inputs[i], err)) continue;
+            failed = true;
+            std::lock_guard<std::mutex> lock(err_lock);
+            std::cerr << opts.inputs[i] << ":" << std::endl << err.str();
+        }
+    };
+    // current thread is also a worker
+    std::size_t jobs = opts.jobs ? opts.jobs
+                                 : std::thread::hardware_concurrency();
+    jobs = std::max<std::size_t>(std::min(jobs, opts.inputs.size()), 1);
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < jobs; ++i) threads.emplace_back(worker);
+    worker();
+    for (auto &&i : threads) i.join();
+    return failed ? 1 : 0;
+}
+
+} // namespace
 
 int main(int argc, const char *argv[]) {
-    //
-    return 0;
+    Options opts;
+    if (!ParseArguments(argc, argv, opts)) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    if (opts.syntax_only) return CheckSyntaxAll(opts);
+    // open input file
+    std::ifstream ifs(opts.input);
+    if (!ifs.is_open()) {
+        std::cerr << "could not open file '" << opts.input << "'";
+        std::cerr << std::endl;
+        return 1;
+    }
+    // compile
+    if (opts.ast_cache || opts.func_cache) {
+        std::string source((std::istreambuf_iterator<char>(ifs)),
+                std::istreambuf_iterator<char>());
+        return CompileCached(source, opts);
+    }
+    Lexer lexer(ifs);
+    Parser parser(lexer);
+    return opts.stream ? CompileStreaming(parser, opts)
+                       : CompileProgram(parser, opts);
 }
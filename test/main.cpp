@@ -1,6 +1,9 @@
 #include <test.h>
 
-#define ALL_TESTS(f) f(LexerTest) f(ParserTest) f(PoolTest) f(LibTest)
+#define ALL_TESTS(f) \
+    f(LexerTest) f(ParserTest) f(FlatASTTest) f(FlatASTCaptureTest) \
+    f(FlatASTFoldTest) f(FlatASTCTFETest) f(SymbolTest) f(PoolTest) \
+    f(LibTest)
 
 // expand function declarations & unit test array
 UNIT_TEST(ALL_TESTS, unit_test);
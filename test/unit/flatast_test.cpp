@@ -0,0 +1,269 @@
+#include <test.h>
+
+#include <sstream>
+#include <vector>
+#include <cstring>
+
+#include <front/parser.h>
+#include <define/flatast.h>
+#include <define/astcache.h>
+#include <unit/util.h>
+
+using namespace std;
+
+namespace {
+
+using Kind = FlatAST::Kind;
+
+const char *program = R"raw(
+    const n = 10;
+    var i, sum = 0;
+
+    function write(x);;
+
+    function fib(n);
+    begin
+        if n <= 2 then fib := 1
+        else fib := fib(n - 1) + fib(n - 2);
+    end;
+
+    procedure calc;
+    begin
+        i := 0;
+        while i < n do begin
+            i := i + 1;
+            if odd i then continue;
+            sum := sum + fib(i) * 2;
+        end;
+    end;
+
+    begin
+        calc;
+        write(sum);
+    end.
+)raw";
+
+const char *nested_program = R"raw(
+    function f(n);
+    var a, b;
+        procedure g;
+        begin
+            a := a + b + n;
+        end;
+    begin
+        g;
+        f := a;
+    end;
+
+    begin
+        f(1);
+    end.
+)raw";
+
+const char *fold_program = R"raw(
+    const a = 2 * 3 + 1, b = a / 2 - 3;
+    var x;
+
+    begin
+        x := a * b + x;
+        if a > b then x := 1 else x := 2;
+        while b <> 0 do x := 3;
+        while x < 10 do begin
+            x := x + 1;
+            break;
+            x := 0;
+        end;
+    end.
+)raw";
+
+const char *ctfe_program = R"raw(
+    var g;
+
+    function fact(n);
+    begin
+        if n <= 1 then fact := 1 else fact := n * fact(n - 1);
+    end;
+
+    function impure(n);
+    begin
+        impure := n + g;
+    end;
+
+    function f(n);
+    const c = fact(4);
+    begin
+        f := c + n;
+    end;
+
+    begin
+        g := f(1) + impure(2);
+    end.
+)raw";
+
+} // namespace
+
+void FlatASTTest() {
+    // initialize parser
+    istringstream iss(program);
+    Lexer lexer(iss);
+    Parser parser(lexer);
+    auto ast = parser.ParseProgram();
+    TEST_EXPECT(false, ast == nullptr);
+    // convert to flat AST
+    FlatAST flat;
+    flat.set_root(ast->Flatten(flat));
+    TEST_EXPECT(EnumCast(Kind::Block), EnumCast(flat.kind(flat.root())));
+    TEST_EXPECT(flat.size() - 1, static_cast<size_t>(flat.root()));
+    TEST_EXPECT(6UL, flat.children(flat.root()).size());
+    // traversal must reach every node exactly once
+    size_t count = 0;
+    flat.Traverse(flat.root(), [&count](FlatAST::NodeId) {
+        ++count;
+        return true;
+    });
+    TEST_EXPECT(flat.size(), count);
+    // dump of flat AST must be the same as dump of AST
+    ostringstream expected, actual;
+    ast->Dump(expected);
+    flat.Dump(actual);
+    TEST_EXPECT(expected.str(), actual.str());
+    // semantic analysis
+    Analyzer ana;
+    TEST_EXPECT(EnumCast(SymbolType::Void), EnumCast(flat.SemaAnalyze(ana)));
+    TEST_EXPECT(0U, ana.error_num());
+    // constants are folded after semantic analysis
+    ostringstream analyzed;
+    flat.Dump(analyzed);
+    TEST_EXPECT(false, actual.str() == analyzed.str());
+    size_t ret_count = 0, tail_count = 0;
+    flat.ForEachNode([&](FlatAST::NodeId id) {
+        if (flat.kind(id) == Kind::Assign
+                && flat.binding(id).type == SymbolType::Ret) {
+            ++ret_count;
+        }
+        if (flat.is_tail(id)) ++tail_count;
+    });
+    TEST_EXPECT(2UL, ret_count);
+    TEST_EXPECT(2UL, tail_count);
+    // serialization
+    auto hash = HashSource(program);
+    ostringstream cache;
+    TEST_EXPECT(true, flat.Save(cache, hash));
+    auto data = cache.str();
+    vector<uint64_t> buffer(data.size() / 8 + 1);
+    memcpy(buffer.data(), data.data(), data.size());
+    FlatAST loaded;
+    TEST_EXPECT(false, loaded.Load(buffer.data(), data.size(), hash + 1));
+    TEST_EXPECT(false, loaded.Load(buffer.data(), data.size() / 2, hash));
+    TEST_EXPECT(true, loaded.Load(buffer.data(), data.size(), hash));
+    TEST_EXPECT(flat.size(), loaded.size());
+    TEST_EXPECT(flat.root(), loaded.root());
+    ostringstream loaded_dump;
+    loaded.Dump(loaded_dump);
+    TEST_EXPECT(analyzed.str(), loaded_dump.str());
+    bool same_bindings = true;
+    flat.ForEachNode([&](FlatAST::NodeId id) {
+        const auto &l = flat.binding(id), &r = loaded.binding(id);
+        if (l.type != r.type || l.depth != r.depth || l.slot != r.slot
+                || flat.is_tail(id) != loaded.is_tail(id)) {
+            same_bindings = false;
+        }
+    });
+    TEST_EXPECT(true, same_bindings);
+}
+
+void FlatASTCaptureTest() {
+    // captured variables of nested procedure
+    FlatAST nested;
+    TEST_EXPECT(true, AnalyzeFlat(nested_program, nested, cerr));
+    size_t by_ref = 0, by_value = 0;
+    nested.ForEachNode([&](FlatAST::NodeId id) {
+        for (const auto &i : nested.captures(id)) {
+            ++(i.by_ref ? by_ref : by_value);
+        }
+    });
+    TEST_EXPECT(1UL, by_ref);
+    TEST_EXPECT(2UL, by_value);
+    // captures survive serialization
+    auto hash = HashSource(nested_program);
+    ostringstream cache;
+    TEST_EXPECT(true, nested.Save(cache, hash));
+    auto data = cache.str();
+    vector<uint64_t> buffer(data.size() / 8 + 1);
+    memcpy(buffer.data(), data.data(), data.size());
+    FlatAST loaded;
+    TEST_EXPECT(true, loaded.Load(buffer.data(), data.size(), hash));
+    bool same_captures = true;
+    nested.ForEachNode([&](FlatAST::NodeId id) {
+        const auto &l = nested.captures(id), &r = loaded.captures(id);
+        if (l.size() != r.size()) same_captures = false;
+        for (size_t i = 0; same_captures && i < l.size(); ++i) {
+            if (GetBindingKey(l[i].bind) != GetBindingKey(r[i].bind)
+                    || l[i].by_ref != r[i].by_ref) {
+                same_captures = false;
+            }
+        }
+    });
+    TEST_EXPECT(true, same_captures);
+}
+
+void FlatASTFoldTest() {
+    // constant folding and dead code elimination
+    FlatAST fold;
+    TEST_EXPECT(true, AnalyzeFlat(fold_program, fold, cerr));
+    size_t kind_count[EnumCast(Kind::Number) + 1] = {0};
+    fold.Traverse(fold.root(), [&](FlatAST::NodeId id) {
+        ++kind_count[EnumCast(fold.kind(id))];
+        return true;
+    });
+    TEST_EXPECT(0UL, kind_count[EnumCast(Kind::If)]);
+    TEST_EXPECT(1UL, kind_count[EnumCast(Kind::While)]);
+    TEST_EXPECT(3UL, kind_count[EnumCast(Kind::Assign)]);
+    TEST_EXPECT(1UL, kind_count[EnumCast(Kind::Control)]);
+    // initializers of constants, '0' ('a * b'), '1', '10' and '1'
+    TEST_EXPECT(6UL, kind_count[EnumCast(Kind::Number)]);
+    // division by zero does not fold, so it can not initialize constants
+    FlatAST div;
+    ostringstream div_err;
+    TEST_EXPECT(false, AnalyzeFlat("const a = 1 / (2 - 2); .", div, div_err));
+    TEST_EXPECT(true, div_err.str().find("non-constant") != string::npos);
+    // neither does overflow in division
+    FlatAST ovf;
+    ostringstream ovf_err;
+    TEST_EXPECT(false, AnalyzeFlat(
+            "const a = -2147483647 - 1, m = 0 - 1, b = a / m; .", ovf,
+            ovf_err));
+    TEST_EXPECT(true, ovf_err.str().find("non-constant") != string::npos);
+    // undefined division in dead code is not an error
+    FlatAST dead;
+    TEST_EXPECT(true,
+            AnalyzeFlat("var x; if 0 = 1 then x := 1 / 0.", dead, cerr));
+}
+
+void FlatASTCTFETest() {
+    // compile-time function evaluation
+    FlatAST ctfe;
+    TEST_EXPECT(true, AnalyzeFlat(ctfe_program, ctfe, cerr));
+    // 'fact(n - 1)' and 'impure(2)' are left to run time
+    size_t fun_calls = 0;
+    bool has_result = false;
+    ctfe.Traverse(ctfe.root(), [&](FlatAST::NodeId id) {
+        if (ctfe.kind(id) == Kind::FunCall) ++fun_calls;
+        if (ctfe.kind(id) == Kind::Number && ctfe.value(id) == 25) {
+            has_result = true;
+        }
+        return true;
+    });
+    TEST_EXPECT(2UL, fun_calls);
+    TEST_EXPECT(true, has_result);
+    // only 'impure' is still called after folding
+    size_t used_funcs = 0;
+    bool is_impure_used = false;
+    ctfe.ForEachNode([&](FlatAST::NodeId id) {
+        if (ctfe.kind(id) != Kind::Function || !ctfe.is_used(id)) return;
+        ++used_funcs;
+        if (ctfe.name(id) == "impure") is_impure_used = true;
+    });
+    TEST_EXPECT(1UL, used_funcs);
+    TEST_EXPECT(true, is_impure_used);
+}
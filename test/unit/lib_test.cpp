@@ -31,6 +31,21 @@ void PoolTest() {
     unit = PoolAccessUnit(id - 1);
     TEST_EXPECT(0xcafebabe, *reinterpret_cast<unsigned int *>(unit->ptr));
     TEST_EXPECT(static_cast<unsigned int>(sizeof(test_var)), unit->size);
+    // arena
+    TEST_EXPECT(0, PoolIsInlineData(unit));
+    auto mark = PoolArenaMark();
+    PoolId id1, id2;
+    unit = PoolArenaAllocaUnit(sizeof(test_var), &id1);
+    TEST_EXPECT(unit, PoolAccessUnit(id1));
+    TEST_EXPECT(1, PoolIsInlineData(unit));
+    TEST_EXPECT(true, unit->size >= sizeof(test_var));
+    PoolArenaAllocaUnit(sizeof(test_var), &id2);
+    TEST_EXPECT(true, PoolAccessUnit(id2) != nullptr);
+    PoolFreeUnit(id2);
+    TEST_EXPECT(static_cast<PoolUnit *>(nullptr), PoolAccessUnit(id2));
+    TEST_EXPECT(unit, PoolAccessUnit(id1));
+    PoolArenaRelease(mark);
+    TEST_EXPECT(static_cast<PoolUnit *>(nullptr), PoolAccessUnit(id1));
 }
 
 void LibTest() {
@@ -82,6 +97,27 @@ void LibTest() {
     TEST_EXPECT(0, freestring(str));
     TEST_EXPECT(0, freestring(s2));
     TEST_EXPECT(0, freestring(s3));
+    // arrays/strings in frame arena
+    int frame = EnterFrame();
+    arr = NewLocalArray();
+    for (int i = 1; i <= 100; ++i) {
+        arraypush(arr, i);
+    }
+    TEST_EXPECT(1, arrayfront(arr));
+    TEST_EXPECT(100, arrayback(arr));
+    str = NewLocalString(3);
+    TEST_EXPECT(3, stringmemlen(str));
+    s2 = newstring(20);
+    for (int i = 0; i < 20; ++i) {
+        setstringpos(s2, i, 'a' + i);
+    }
+    TEST_EXPECT(str, stringassign(str, s2));
+    TEST_EXPECT(0, stringcompare(str, s2));
+    TEST_EXPECT(0, freestring(s2));
+    TEST_EXPECT(0, freestring(str));
+    TEST_EXPECT(0, freearray(arr));
+    LeaveFrame(frame);
+    TEST_EXPECT(frame, EnterFrame());
     str = newstring(3);
     setstringpos(str, 0, '1');
     setstringpos(str, 1, '.');
@@ -111,4 +147,10 @@ void LibTest() {
     TEST_EXPECT(0, stringcompare(str, s2));
     TEST_EXPECT(0, freestring(str));
     TEST_EXPECT(0, freestring(s2));
+    // sys
+    char arg0[] = "pl01", arg1[] = "test.pl0";
+    char *args[] = {arg0, arg1};
+    SetCommandLineArgs(2, args);
+    TEST_EXPECT(2, getargcount());
+    TEST_EXPECT(8, stringlen(getargvalue(1)));
 }
@@ -61,6 +61,22 @@ const char *program1 = R"raw(
     main.
 )raw";
 
+const char *program2 = R"raw(
+    begin
+        x := a + b + c + d;
+        x := a - b - c - d;
+        x := -a * b * c / d;
+        x := f(a, (b + 1) * 2, g(-c));
+        x := a * ((-b));
+        x := -(-b);
+        x := 1 + f(-1, 2)
+    end.
+)raw";
+
+bool Contains(const string &str, const char *sub) {
+    return str.find(sub) != string::npos;
+}
+
 } // namespace
 
 void ParserTest() {
@@ -81,4 +97,69 @@ void ParserTest() {
     ast = parser.ParseProgram();
     TEST_EXPECT(false, ast == nullptr);
     TEST_EXPECT(0U, lexer.error_num() + parser.error_num());
+    // test streaming interface
+    iss.str(program0);
+    iss.clear();
+    parser.Reset();
+    TEST_EXPECT(false, parser.ParseGlobalConsts() == nullptr);
+    TEST_EXPECT(false, parser.ParseGlobalVars() == nullptr);
+    int proc_func_count = 0;
+    while (parser.ParseGlobalProcFunc()) ++proc_func_count;
+    TEST_EXPECT(2, proc_func_count);
+    TEST_EXPECT(false, parser.ParseMainStatement() == nullptr);
+    TEST_EXPECT(0U, lexer.error_num() + parser.error_num());
+    // test expressions
+    iss.str(program2);
+    iss.clear();
+    parser.Reset();
+    ast = parser.ParseProgram();
+    TEST_EXPECT(false, ast == nullptr);
+    ostringstream oss;
+    if (ast) ast->Dump(oss);
+    auto dump = oss.str();
+    TEST_EXPECT(true, Contains(dump, "Add(Add(a, b), Add(c, d))"));
+    TEST_EXPECT(true, Contains(dump, "Sub(Sub(a, b), Add(c, d))"));
+    TEST_EXPECT(true, Contains(dump, "Sub(0, Div(Mul(a, Mul(b, c)), d))"));
+    TEST_EXPECT(true, Contains(dump, "f(a, Mul(Add(b, 1), 2), g(Sub(0, c)))"));
+    // leading sign in parentheses and the first argument of call
+    TEST_EXPECT(true, Contains(dump, "Mul(a, Sub(0, b))"));
+    TEST_EXPECT(true, Contains(dump, "Sub(0, Sub(0, b))"));
+    TEST_EXPECT(true, Contains(dump, "Add(1, f(Sub(0, 1), 2))"));
+    // test long expression
+    string expr = "var x = 1";
+    for (int i = 0; i < 100000; ++i) expr += " + 1";
+    iss.str(expr + ";.");
+    iss.clear();
+    parser.Reset();
+    ast = parser.ParseProgram();
+    TEST_EXPECT(false, ast == nullptr);
+    TEST_EXPECT(0U, lexer.error_num() + parser.error_num());
+    // test parse errors
+    iss.str("x := (a + b.");
+    iss.clear();
+    parser.Reset();
+    TEST_EXPECT(true, parser.ParseProgram() == nullptr);
+    TEST_EXPECT(1U, parser.error_num());
+    iss.str("x := f(a, b.");
+    iss.clear();
+    parser.Reset();
+    TEST_EXPECT(true, parser.ParseProgram() == nullptr);
+    TEST_EXPECT(1U, parser.error_num());
+    // test recognizer mode
+    ostringstream err;
+    Lexer rec_lexer(iss, err);
+    Parser recognizer(rec_lexer, true);
+    for (const auto &i : {program0, program1, program2}) {
+        iss.str(i);
+        iss.clear();
+        recognizer.Reset();
+        TEST_EXPECT(true, recognizer.ParseProgram() == nullptr);
+        TEST_EXPECT(0U, rec_lexer.error_num() + recognizer.error_num());
+    }
+    iss.str("x := f(a, (b + 1) * 2.");
+    iss.clear();
+    recognizer.Reset();
+    recognizer.ParseProgram();
+    TEST_EXPECT(1U, recognizer.error_num());
+    TEST_EXPECT(true, Contains(err.str(), "')' required"));
 }
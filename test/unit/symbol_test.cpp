@@ -0,0 +1,67 @@
+#include <test.h>
+
+#include <string>
+
+#include <define/symbol.h>
+
+using namespace std;
+
+void SymbolTest() {
+    SymbolTable table;
+    table.PushScope();
+    table.AddSymbol("a", {SymbolType::Var, 0});
+    table.AddSymbol("b", {SymbolType::Const, 0});
+    TEST_EXPECT(true, table.GetInfo("a").type == SymbolType::Var);
+    TEST_EXPECT(true, table.GetInfo("c").type == SymbolType::Error);
+    TEST_EXPECT(true, table.IsDefinedInScope("a"));
+    // shadowing
+    table.PushScope();
+    TEST_EXPECT(false, table.IsDefinedInScope("a"));
+    table.AddOuterSymbol("f", {SymbolType::Func, 1});
+    table.AddSymbol("f", {SymbolType::Ret, 1});
+    table.AddSymbol("a", {SymbolType::Const, 0});
+    TEST_EXPECT(true, table.GetInfo("a").type == SymbolType::Const);
+    TEST_EXPECT(true, table.GetInfo("f").type == SymbolType::Ret);
+    TEST_EXPECT(true, table.IsDefinedInScope("f", 1));
+    TEST_EXPECT(true, table.IsDefinedInScope("a", 1));
+    TEST_EXPECT(false, table.IsDefinedInScope("b"));
+    // bindings
+    auto bind = table.GetBinding("a");
+    TEST_EXPECT(2U, bind.depth);
+    TEST_EXPECT(1U, bind.slot);
+    bind = table.GetBinding("f", 1);
+    TEST_EXPECT(true, bind.type == SymbolType::Func);
+    TEST_EXPECT(1U, bind.depth);
+    TEST_EXPECT(2U, bind.slot);
+    TEST_EXPECT(true, table.GetBinding("c").type == SymbolType::Error);
+    table.PopScope();
+    TEST_EXPECT(true, table.GetInfo("a").type == SymbolType::Var);
+    TEST_EXPECT(true, table.GetInfo("f").type == SymbolType::Func);
+    TEST_EXPECT(static_cast<size_t>(1), table.GetInfo("f").func_arg_count);
+    // lots of symbols and deep nesting
+    for (int i = 0; i < 1000; ++i) {
+        table.PushScope();
+        table.AddSymbol("v" + to_string(i), {SymbolType::Var, 0});
+    }
+    TEST_EXPECT(static_cast<size_t>(1001), table.depth());
+    TEST_EXPECT(true, table.GetInfo("v0").type == SymbolType::Var);
+    TEST_EXPECT(true, table.GetInfo("v999").type == SymbolType::Var);
+    for (int i = 0; i < 1000; ++i) table.PopScope();
+    TEST_EXPECT(true, table.GetInfo("v0").type == SymbolType::Error);
+    TEST_EXPECT(true, table.GetInfo("b").type == SymbolType::Const);
+    // snapshot, only the first 3 symbols are visible
+    table.AddSymbol("g", {SymbolType::Var, 0});
+    SymbolTable inner(table, 3);
+    inner.PushScope();
+    inner.AddSymbol("x", {SymbolType::Var, 0});
+    TEST_EXPECT(static_cast<size_t>(2), inner.depth());
+    TEST_EXPECT(true, inner.GetInfo("f").type == SymbolType::Func);
+    TEST_EXPECT(true, inner.GetInfo("g").type == SymbolType::Error);
+    TEST_EXPECT(false, inner.IsDefinedInScope("a"));
+    bind = inner.GetBinding("b");
+    TEST_EXPECT(1U, bind.depth);
+    TEST_EXPECT(1U, bind.slot);
+    bind = inner.GetBinding("x");
+    TEST_EXPECT(2U, bind.depth);
+    TEST_EXPECT(0U, bind.slot);
+}
@@ -2,10 +2,31 @@
 #define PL01_TEST_UNIT_UTIL_H_
 
 #include <type_traits>
+#include <sstream>
+#include <ostream>
+
+#include <front/lexer.h>
+#include <front/parser.h>
+#include <front/analyzer.h>
+#include <define/flatast.h>
 
 template <typename T>
 typename std::underlying_type<T>::type EnumCast(T value) {
     return static_cast<typename std::underlying_type<T>::type>(value);
 }
 
+// parse 'src', convert it to flat AST 'out' and analyze it,
+// returns false if there are any errors, which are printed to 'err'
+inline bool AnalyzeFlat(const char *src, FlatAST &out, std::ostream &err) {
+    std::istringstream iss(src);
+    Lexer lexer(iss, err);
+    Parser parser(lexer);
+    auto ast = parser.ParseProgram();
+    if (!ast || lexer.error_num() || parser.error_num()) return false;
+    out.set_root(ast->Flatten(out));
+    Analyzer ana(err);
+    out.SemaAnalyze(ana);
+    return !ana.error_num();
+}
+
 #endif // PL01_TEST_UNIT_UTIL_H_